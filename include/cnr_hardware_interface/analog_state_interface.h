@@ -63,7 +63,12 @@ public:
     }
   }
 
-  std::string getName() const
+  // the reference lives as long as the handle: a temporary handle (e.g. iface.getHandle(n).getName()) returns a copy
+  const std::string& getName() const&
+  {
+    return name_;
+  }
+  std::string getName() const&&
   {
     return name_;
   }
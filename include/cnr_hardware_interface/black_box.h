@@ -0,0 +1,208 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_BLACK_BOX_H
+#define CNR_HARDWARE_INTERFACE_BLACK_BOX_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cnr_hardware_interface/cnr_robot_hw_status.h>
+#include <cnr_hardware_interface/hardware_buffer.h>
+#include <cnr_hardware_interface/internal/phase_timing.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Header of the files dumped by the BlackBoxRecorder.
+ *
+ * [BlackBoxFileHeader][names: (joints + analogs + force_torques + digitals + phases) x kNameSize chars][columns]
+ *
+ * The columns are in chronological order, each one 'samples' long:
+ *   cycle, stamp_ns, state (uint64_t),
+ *   last duration [s] of each RTPhase, position, velocity, effort, command position, command velocity,
+ *   command effort (one column per joint), analog value, analog command (one column per analog), wrench, wrench
+ *   command (6 columns per force-torque sensor: force x, y, z, torque x, y, z) (double),
+ *   digital value, digital command (one column per digital) (uint8_t)
+ */
+struct BlackBoxFileHeader
+{
+  static constexpr uint32_t kVersion  = 2;
+  static constexpr uint32_t kNameSize = 64;
+
+  char     magic[8];  // "CNRHWBB"
+  uint32_t version;
+  uint32_t joints;
+  uint32_t analogs;
+  uint32_t force_torques;
+  uint32_t digitals;
+  uint32_t phases;
+  uint32_t trigger_state;  // the StatusHw that froze the recorder (the current one, if dumped on demand)
+  uint64_t samples;
+  uint64_t trigger_stamp_ns;
+};
+
+/**
+ * @brief Preallocated ring of the last samples of the RobotHW: one sample per cycle, with the state, the commands
+ * and the duration of each phase.
+ *
+ * record() is RT-safe and it is called by the RT thread only. trigger() is RT-safe and it can be called by any
+ * thread: the ring stops recording (it is frozen) until the background thread has dumped it in a file and
+ * rearmed it, so the samples that preceded the fault are not overwritten.
+ */
+class BlackBoxRecorder
+{
+public:
+  BlackBoxRecorder();
+
+  /**
+   * @brief Not RT-safe. It allocates the ring, 0 disables the recorder.
+   */
+  void resize(const HardwareBuffer& buffer, const std::size_t samples);
+  bool enabled() const
+  {
+    return capacity_ > 0;
+  }
+  std::size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  void record(const uint64_t cycle, const StatusHw& state, const PhaseTimingStats& timing, const HardwareBuffer& buffer);
+
+  /**
+   * @brief Freeze the ring. The first trigger wins, up to the rearm.
+   */
+  void trigger(const StatusHw& reason);
+  bool triggered() const
+  {
+    return trigger_.load() != 0;
+  }
+
+  /**
+   * @brief Not RT-safe, called by the background thread if triggered(). It waits for the sample in progress (if
+   * any), writes the memory-mapped file and rearms the recorder.
+   */
+  bool dump(const std::string& path, std::string* what = nullptr);
+
+  uint64_t dumps() const
+  {
+    return dumps_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::size_t rowSize() const;
+
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> analog_names_;
+  std::vector<std::string> ft_names_;
+  std::vector<std::string> digital_names_;
+  std::size_t              capacity_;
+  std::vector<uint64_t>    rows_;  // row-major: cheap to append, transposed in columns by dump()
+  uint64_t                 head_;  // written samples, by the RT thread only
+
+  std::atomic<uint64_t>    writing_;  // odd while record() is writing a row
+  std::atomic<uint32_t>    trigger_;  // 0, or the reason + 1
+  std::atomic<uint64_t>    trigger_stamp_ns_;
+  std::atomic<uint64_t>    dumps_;
+};
+
+/**
+ * @brief Read-only memory map of a file written by BlackBoxRecorder::dump()
+ */
+class BlackBoxFile
+{
+public:
+  BlackBoxFile();
+  ~BlackBoxFile();
+
+  BlackBoxFile(const BlackBoxFile&) = delete;
+  BlackBoxFile& operator=(const BlackBoxFile&) = delete;
+
+  bool open(const std::string& path, std::string* what = nullptr);
+  void close();
+
+  const BlackBoxFileHeader& header() const
+  {
+    return *header_;
+  }
+  std::size_t samples() const
+  {
+    return header_ ? header_->samples : 0;
+  }
+  const std::vector<std::string>& jointNames() const { return joint_names_; }
+  const std::vector<std::string>& analogNames() const { return analog_names_; }
+  const std::vector<std::string>& forceTorqueNames() const { return ft_names_; }
+  const std::vector<std::string>& digitalNames() const { return digital_names_; }
+  const std::vector<std::string>& phaseNames() const { return phase_names_; }
+
+  const uint64_t* cycle() const;
+  const uint64_t* stamp() const;
+  const uint64_t* state() const;
+  const double*   phase(const std::size_t i) const;
+  const double*   position(const std::size_t joint) const;
+  const double*   velocity(const std::size_t joint) const;
+  const double*   effort(const std::size_t joint) const;
+  const double*   commandPosition(const std::size_t joint) const;
+  const double*   commandVelocity(const std::size_t joint) const;
+  const double*   commandEffort(const std::size_t joint) const;
+  const double*   analogValue(const std::size_t analog) const;
+  const double*   analogCommand(const std::size_t analog) const;
+  /**
+   * @param component 0-2 force x, y, z, 3-5 torque x, y, z
+   */
+  const double*   wrench(const std::size_t sensor, const std::size_t component) const;
+  const double*   wrenchCommand(const std::size_t sensor, const std::size_t component) const;
+  const uint8_t*  digitalValue(const std::size_t digital) const;
+  const uint8_t*  digitalCommand(const std::size_t digital) const;
+
+private:
+  const double* doubleColumn(const std::size_t i) const;
+
+  void*                     map_;
+  std::size_t               size_;
+  const BlackBoxFileHeader* header_;
+  const char*               columns_;
+  std::vector<std::string>  joint_names_;
+  std::vector<std::string>  analog_names_;
+  std::vector<std::string>  ft_names_;
+  std::vector<std::string>  digital_names_;
+  std::vector<std::string>  phase_names_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_BLACK_BOX_H
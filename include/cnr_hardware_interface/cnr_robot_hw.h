@@ -42,10 +42,14 @@
 #include <map>
 #include <mutex>  // NOLINT
 #include <functional>
+#include <future>
 #include <thread>  // NOLINT
+#include <memory>
+#include <atomic>
 
 #include <ros/ros.h>
 #include <ros/callback_queue.h>
+#include <diagnostic_updater/diagnostic_updater.h>
 #include <realtime_utilities/diagnostics_interface.h>
 #include <cnr_logger/cnr_logger.h>
 
@@ -53,7 +57,26 @@
 #include <configuration_msgs/SetConfig.h>
 #include <configuration_msgs/GetConfig.h>
 #include <cnr_hardware_interface/cnr_robot_hw_status.h>
+#include <cnr_hardware_interface/hardware_buffer.h>
+#include <cnr_hardware_interface/shm_state.h>
+#include <cnr_hardware_interface/black_box.h>
+#include <cnr_hardware_interface/io_change_interface.h>
+#include <cnr_hardware_interface/force_torque_state_interface.h>
 #include <cnr_hardware_interface/internal/cnr_robot_hw_utils.h>
+#include <cnr_hardware_interface/internal/phase_timing.h>
+#include <cnr_hardware_interface/internal/rt_log_queue.h>
+#include <cnr_hardware_interface/internal/mailbox.h>
+#include <cnr_hardware_interface/internal/resource_index.h>
+#include <cnr_hardware_interface/internal/controller_registry.h>
+#include <cnr_hardware_interface/internal/state_transitions.h>
+#include <cnr_hardware_interface/internal/status_snapshots.h>
+#include <cnr_hardware_interface/internal/command_channel.h>
+#include <cnr_hardware_interface/internal/rt_alloc_guard.h>
+#include <cnr_hardware_interface/internal/param_cache.h>
+#include <cnr_hardware_interface/internal/parameter_block.h>
+#include <cnr_hardware_interface/internal/wrench_processing.h>
+#include <cnr_hardware_interface/internal/command_limits.h>
+#include <cnr_hardware_interface/internal/sub_devices.h>
 
 
 namespace cnr_hardware_interface
@@ -90,6 +113,14 @@ public:
    * before the infinite loop.
    */
   bool init(ros::NodeHandle& root_nh, ros::NodeHandle &robot_hw_nh) final;
+
+  /**
+   * @brief init() in a new thread, so that many RobotHW (e.g. with a long fieldbus discovery or homing in doInit())
+   * can be initialized in parallel. The state is INITIALIZING until the end, then INITIALIZED (or ERROR).
+   * The RobotHW must not be destroyed, nor used out of getState(), before the future is ready.
+   * @return the result of init()
+   */
+  std::future<bool> initAsync(const ros::NodeHandle& root_nh, const ros::NodeHandle& robot_hw_nh);
   void read(const ros::Time& time, const ros::Duration& period) final;
   void write(const ros::Time& time, const ros::Duration& period) final;
   bool prepareSwitch(const std::list< hardware_interface::ControllerInfo >& start_list,
@@ -100,6 +131,11 @@ public:
   SwitchState switchResult() const final;
   SwitchState switchResult(const hardware_interface::ControllerInfo& controller) const final;
   bool checkForConflict(const std::list< hardware_interface::ControllerInfo >& info) const final;
+  /**
+   * @brief It stops the background thread (RT log, param services) and the callbacks thread, then calls doShutdown().
+   * The derived classes must call it in their destructor: ~RobotHW() calls it too, but when the derived members are
+   * already destroyed, and the subscription callbacks or the overrides of the derived class could run meanwhile.
+   */
   bool shutdown();
   // ======================================================= End - final methods
 
@@ -141,6 +177,12 @@ public:
   {
     return true;
   }
+  /**
+   * @brief Called in the RT loop by doSwitch(). If the hardware needs more cycles to switch the resources of a
+   * controller (e.g. a change of the drive mode), call deferControllerSwitch() on it, and then
+   * completeControllerSwitch() in a later doRead()/doWrite(). In the meanwhile, switchResult(controller) is ONGOING
+   * for the deferred controllers only.
+   */
   virtual bool doDoSwitch(const std::list<hardware_interface::ControllerInfo>& /*start_list*/,
                           const std::list<hardware_interface::ControllerInfo>& /*stop_list*/)
   {
@@ -158,6 +200,7 @@ public:
   void setResourceNames(const std::vector<std::string>& resource_names)
   {
     m_resource_names = resource_names;
+    indexResourceNames();
   }
   const std::vector<std::string>& resourceNames() const {return m_resource_names;}
   size_t resourceNumber() const {return m_resource_names.size();}
@@ -165,26 +208,240 @@ public:
 
 
   // ======================================================= utils
-  const cnr_hardware_interface::StatusHw&  getState() const
+  cnr_hardware_interface::StatusHw getState() const
   {
-    return m_state;
+    return m_state.load(std::memory_order_acquire);
   }
   const std::string& getRobotHwNamespace() const
   {
     return m_robothw_nh.getNamespace();
   }
+  /**
+   * @return the period of the control loop [s], from the parameter 'sampling_period' (default 1e-3)
+   */
+  double getSamplingPeriod() const
+  {
+    return m_sampling_period;
+  }
+
+  /**
+   * @brief In RT mode the trace of read() and write() is skipped (a single branch per call). It is loaded from the
+   * parameter 'rt_mode' (default false). The trace can be also compiled out with the cmake option CNR_HW_RT_TRACE=OFF
+   */
+  void setRTMode(bool rt_mode)
+  {
+    m_rt_mode = rt_mode;
+  }
+  bool isRTMode() const
+  {
+    return m_rt_mode;
+  }
+
+  /**
+   * @brief If the parameter 'callbacks_thread' is true, the callback queue of the RobotHW (whatever the derived class
+   * subscribes with the robothw_nh; the services 'readParams' and 'writeParams' never run in read()) is processed by a dedicated
+   * no-RT thread, and no longer inside read(). In this case, the callbacks have to pass the data to the RT methods
+   * through a lock-free cnr_hardware_interface::Mailbox.
+   */
+  bool callbacksInRT() const
+  {
+    return m_callbacks_in_rt;
+  }
   // ======================================================= END - utils
 
+  // ======================================================= diagnostics
+  /**
+   * @brief Per-phase timing (see cnr_hardware_interface::RTPhase): mean, max, min and jitter over the last
+   * 'timing_window' samples, and percentiles (p50, p99, p99.9) since the start. The stats are filled by the RT
+   * thread without locking or allocating, while this function is meant to be added to the
+   * diagnostic_updater::Updater of the nodelet.
+   */
+  void diagnosticsTiming(diagnostic_updater::DiagnosticStatusWrapper& stat);
+  const cnr_hardware_interface::PhaseTimingStats& phaseTiming() const
+  {
+    return *m_phase_timing;
+  }
+
+  /**
+   * @brief RT-safe. It freezes the black box (enabled by the param 'black_box_duration' [s]), and the background
+   * thread dumps it in 'black_box_directory'. The black box is dumped on ERROR and CTRL_ERROR as well.
+   * @return false if the black box is disabled
+   */
+  bool dumpBlackBox();
+
+  /**
+   * @brief Any thread: the bias of the processed wrench of the sensor is taken at the next read()
+   * @return false if the sensor has no processing stage (see addWrenchProcessing())
+   */
+  bool tareWrench(const std::string& sensor);
+
+  /**
+   * @brief Any thread. A non-finite command or a stale joint (see the params 'joint_limits' and
+   * 'command_watchdog_cycles') moves the RobotHW in CTRL_ERROR, and the faulty joint is held: a non-finite command
+   * is replaced at each write(), a stale joint is held at the measured position up to its next command. The state
+   * stays CTRL_ERROR (and the controller switches are refused) until this function moves it back to RUNNING, or
+   * the RobotHW is initialized again.
+   * @return false if the state is not a CTRL_ERROR raised by the command checks, or if a joint is still held
+   */
+  bool resetCommandFault();
+  // ======================================================= END - diagnostics
+
 protected:
+  /**
+   * @brief The service 'writeParams', processed by the background thread. The batch of the new values of the
+   * tunable parameters (see declareParameter()) is read with a single call from the struct '~tuning' of the param
+   * server. It is refused as a whole if a name has not been declared or a value is not a number, otherwise it is
+   * applied at the beginning of the next read().
+   */
   virtual bool setParamServer(configuration_msgs::SetConfigRequest& req, configuration_msgs::SetConfigResponse& res);
+
+  /**
+   * @brief The service 'readParams', processed by the background thread: all the tunable parameters are written
+   * with a single call in the struct '~tuning' of the param server.
+   */
   virtual bool getParamServer(configuration_msgs::GetConfigRequest& req, configuration_msgs::GetConfigResponse& res);
 
+  /**
+   * @brief Not RT-safe, call it in doInit(). It declares a parameter that can be tuned live by 'writeParams'.
+   * The services 'writeParams' and 'readParams' are advertised at the end of a successful init(), and the
+   * declarations are refused since then.
+   * @return the index for parameter(), or an invalid index (not less than the number of parameters) if refused
+   */
+  std::size_t declareParameter(const std::string& name, const double value)
+  {
+    const std::size_t idx = m_parameters.declare(name, value);
+    if(idx == m_parameters.size())
+    {
+      CNR_ERROR(m_logger, "The parameter '" << name << "' cannot be declared after init()");
+    }
+    return idx;
+  }
+
+  /**
+   * @brief RT-safe: the value of a tunable parameter, stable for the whole cycle
+   */
+  double parameter(const std::size_t index) const
+  {
+    return m_parameters.value(index);
+  }
+
+  /**
+   * @brief RT-safe: it changes at each batch applied by 'writeParams'
+   */
+  uint64_t parametersVersion() const
+  {
+    return m_parameters.version();
+  }
+
+  /**
+   * @brief Lock-free and RT-safe, it can be called by any thread. The transition is refused (and recorded as such)
+   * if it is not valid, see cnr_hardware_interface::isValidTransition().
+   * @return false if the transition has been refused
+   */
   bool setState(const cnr_hardware_interface::StatusHw& status) const;
 
+  /**
+   * @brief RT-safe logging: the message is copied in a preallocated ring, and it is forwarded to m_logger by a
+   * background thread. Use it in doRead/doWrite/doDoSwitch instead of the CNR_* macros.
+   * @return false if the ring was full, and the record has been dropped
+   */
+  bool rtLog(const cnr_hardware_interface::RTLogLevel& level, const char* msg)
+  {
+    return m_rt_log.push(level, msg);
+  }
+  uint64_t rtLogDropped() const
+  {
+    return m_rt_log.dropped();
+  }
+
+  /**
+   * @brief The parameters of the robothw_nh namespace, fetched once before doInit(). Read the configuration of the
+   * driver from here, instead of calling the parameter server at each key.
+   */
+  const cnr_hardware_interface::ParamCache& params() const
+  {
+    return m_params;
+  }
+
+  /**
+   * @brief Registers all the handles of the buffer in the interface, and the interface in the RobotHW.
+   * Call m_buffer.resize() first, e.g. m_buffer.resize(resourceNames()) in doInit().
+   */
+  template<class Interface>
+  void registerBufferInterface(Interface& iface)
+  {
+    m_buffer.registerHandles(iface);
+    registerInterface(&iface);
+  }
+
+  /**
+   * @brief Not RT-safe, call it in doInit() after m_buffer.resize(). Since then, write() publishes the commands of
+   * m_buffer (joints, analog, digital and wrench) in m_command_channel, before calling doWrite(). The driver takes the frames from the channel, in
+   * doWrite() or in its own bus I/O thread.
+   */
+  void enableCommandChannel();
+
+  /**
+   * @brief Not RT-safe, call it in doInit() after m_buffer.resize(). Since then, read() computes after doRead() the
+   * digital channels that toggled and the analog channels that moved more than analog_deadband (see
+   * ioChanges()), and the controllers get them through the hardware_interface::IOChangeInterface (handle 'io_changes').
+   */
+  void enableIOChangeDetection(const double analog_deadband = 0.0);
+  const cnr_hardware_interface::IOChangeDetector& ioChanges() const
+  {
+    return m_io_changes;
+  }
+
+  /**
+   * @brief Not RT-safe, call it in doInit(), after the handle 'sensor' has been registered in iface. Since then,
+   * read() processes the wrench of the sensor after doRead() (saturation check, low-pass filter, tare, static
+   * transform, see cnr_hardware_interface::WrenchProcessor), and the result is the handle 'sensor/filtered' of iface.
+   * The configuration is read from the params 'ft_processing/<sensor>/' (cutoff_frequency, force_limit,
+   * torque_limit, frame_id, translation, rotation_rpy).
+   */
+  bool addWrenchProcessing(hardware_interface::ForceTorqueStateInterface& iface, const std::string& sensor);
+  bool addWrenchProcessing(hardware_interface::ForceTorqueStateInterface& iface, const std::string& sensor,
+                           const cnr_hardware_interface::WrenchProcessingConfig& config);
+
+  typedef std::function<bool(const ros::Time&, const ros::Duration&)> SubDeviceCallback;
+
+  /**
+   * @brief Not RT-safe, call it in doInit(). The sub-device is read after doRead() and written after doWrite(), but
+   * only in the cycles where cycle % divisor == phase, and the period given to the callbacks is divisor times the
+   * period of read()/write(). The params 'sub_devices/<name>/divisor' and 'sub_devices/<name>/phase' override the
+   * arguments. A call longer than budget [s] (default: the sampling period) is an overrun in the diagnostics; a
+   * failed call moves the RobotHW in ERROR, as doRead() and doWrite(). An empty callback is skipped.
+   */
+  bool registerSubDevice(const std::string& name, const SubDeviceCallback& read, const SubDeviceCallback& write,
+                         const unsigned int divisor, const unsigned int phase = 0, const double budget = 0.0);
+
+  /**
+   * @brief To be called inside doDoSwitch(): the switch of the controller is concluded later, by
+   * completeControllerSwitch(). The state of the RobotHW stays DOING_SWITCH until all the deferred switches are done.
+   * @return false if the controller is not involved in the switch
+   */
+  bool deferControllerSwitch(const std::string& controller);
+
+  /**
+   * @brief RT-safe. It concludes a switch deferred by deferControllerSwitch(). If ok is false, the switch of the
+   * controller fails, and the RobotHW goes in CTRL_ERROR.
+   */
+  bool completeControllerSwitch(const std::string& controller, const bool ok = true);
+
 private:
   virtual bool enterInit(ros::NodeHandle& root_nh, ros::NodeHandle &robot_hw_nh);
   virtual bool exitInit();
 
+  void indexResourceNames();
+  void startBackgroundThread();
+  void stopBackgroundThread();
+  void backgroundLoop();
+  void callbacksLoop();
+  void flushRTLog();
+  void flushStateTransitions();
+  void flushStatusSnapshots();
+  void flushBlackBox();
+
 protected:
 
   double                                           m_sampling_period;
@@ -192,9 +449,10 @@ protected:
   ros::NodeHandle                                  m_root_nh;
   ros::NodeHandle                                  m_robothw_nh;
   ros::CallbackQueue                               m_robot_hw_queue;
+  ros::CallbackQueue                               m_params_queue;  // readParams and writeParams, background thread
   mutable cnr_logger::TraceLogger                  m_logger;
 
-  SetStatusParamFcn                                m_set_status_param;
+  SetStatusParamFcn                                m_set_status_param;  // called by the background thread
 
   std::mutex                                       m_mutex;
   ros::ServiceServer                               m_get_param;
@@ -202,17 +460,74 @@ protected:
   bool                                             m_stop_thread;
 
   bool                                             m_is_first_read;
-  mutable cnr_hardware_interface::StatusHw         m_state;
-  mutable cnr_hardware_interface::StatusHw         m_state_prev;
-  //mutable std::vector<std::string>                 m_state_history;
+  mutable std::atomic<cnr_hardware_interface::StatusHw> m_state;
+  mutable std::atomic<cnr_hardware_interface::StatusHw> m_state_prev;
+  mutable cnr_hardware_interface::StateTransitionRing   m_state_history;
+  uint64_t                                         m_state_history_reported_drops;
   
-  std::list< hardware_interface::ControllerInfo >  m_active_controllers;
+  std::list< hardware_interface::ControllerInfo >  m_active_controllers;  // read-only, see m_controllers
   bool                                             m_shutted_down;
 
+  std::unique_ptr<cnr_hardware_interface::PhaseTimingStats> m_phase_timing;
+  uint64_t                                         m_last_read_ns;
+  bool                                             m_rt_mode;
+
+  cnr_hardware_interface::RTLogQueue               m_rt_log;
+  uint64_t                                         m_rt_log_reported_drops;
+  std::thread                                      m_background_thread;
+  std::thread                                      m_callbacks_thread;
+  bool                                             m_callbacks_in_rt;
+  std::atomic<bool>                                m_stop_background;
+
+  cnr_hardware_interface::StatusSnapshotRequests   m_status_snapshots;
+  std::mutex                                       m_status_snapshots_mutex;
+  std::atomic<double>                              m_last_persist_latency;
+
+  cnr_hardware_interface::HardwareBuffer           m_buffer;  // joint and I/O storage, see registerBufferInterface
+  cnr_hardware_interface::CommandChannel           m_command_channel;  // see enableCommandChannel
+  bool                                             m_command_channel_enabled;
+  // limits loaded from 'joint_limits/<joint>/' and watchdog of 'command_watchdog_cycles', enforced before doWrite()
+  cnr_hardware_interface::CommandLimiter           m_command_limits;
+  bool                                             m_command_limits_enabled;
+  std::atomic<bool>                                m_command_fault;  // CTRL_ERROR raised by m_command_limits
+  cnr_hardware_interface::IOChangeDetector         m_io_changes;  // see enableIOChangeDetection
+  hardware_interface::IOChangeInterface            m_io_change_interface;
+  bool                                             m_io_changes_enabled;
+
+  struct WrenchChannel
+  {
+    std::string                             sensor;
+    const double*                           force;
+    const double*                           torque;
+    cnr_hardware_interface::WrenchProcessor processor;
+    bool                                    saturated;
+  };
+  std::vector<std::unique_ptr<WrenchChannel>>      m_wrench_channels;  // see addWrenchProcessing
+
+  cnr_hardware_interface::SubDeviceScheduler       m_sub_devices;  // see registerSubDevice
+  uint64_t                                         m_read_cycles;
+  uint64_t                                         m_sub_device_cycle;
+  // the time and the period of the last read() and write(), by SubDeviceScheduler::Stage
+  ros::Time     m_sub_device_time[static_cast<std::size_t>(cnr_hardware_interface::SubDeviceScheduler::Stage::COUNT)];
+  ros::Duration m_sub_device_period[static_cast<std::size_t>(cnr_hardware_interface::SubDeviceScheduler::Stage::COUNT)];
+
+  cnr_hardware_interface::RTAllocStats             m_rt_alloc_stats;  // only with -DCNR_HW_RT_ALLOC_CHECK=ON
+  cnr_hardware_interface::ParamCache               m_params;  // see params()
+  cnr_hardware_interface::ParameterBlock           m_parameters;  // see declareParameter()
+
+  uint64_t                                         m_write_cycles;
+  cnr_hardware_interface::ShmStatePublisher        m_shm_state;  // only if the param 'shm_state_name' is set
+  mutable cnr_hardware_interface::BlackBoxRecorder m_black_box;  // see dumpBlackBox
+  std::string                                      m_black_box_directory;
+
 
 
 private:
-    std::vector<std::string> m_resource_names;
+  std::vector<std::string>                         m_resource_names;
+  cnr_hardware_interface::ResourceIndex            m_resource_index;
+  mutable cnr_hardware_interface::ResourceBitset   m_claimed_resources;
+  mutable cnr_hardware_interface::ResourceBitset   m_controller_resources;
+  cnr_hardware_interface::ControllerRegistry       m_controllers;
 };
 
 typedef std::shared_ptr<RobotHW> RobotHWSharedPtr;
@@ -61,6 +61,7 @@ BEGIN_ENUM(StatusHw)
   DECL_ENUM_ELEMENT(SRV_ERROR),
   DECL_ENUM_ELEMENT(UNKOWN),  // if the standard hardware_interface::RobotHW is used and 
                               // not the cnr_hardware_itnerface::RobotHW
+  DECL_ENUM_ELEMENT(INITIALIZING),  // init() in progress, see RobotHW::initAsync(). Appended to keep the values above
 }
 END_ENUM(StatusHw);
 
@@ -61,7 +61,11 @@ public:
     }
   }
 
-  std::string getName() const
+  const std::string& getName() const&
+  {
+    return name_;
+  }
+  std::string getName() const&&
   {
     return name_;
   }
@@ -0,0 +1,175 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_FIXED_DOF_ROBOT_HW_H
+#define CNR_HARDWARE_INTERFACE_FIXED_DOF_ROBOT_HW_H
+
+#include <array>
+#include <bitset>
+#include <list>
+#include <string>
+#include <vector>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <cnr_hardware_interface/cnr_robot_hw.h>
+#include <cnr_hardware_interface/veleff_command_interface.h>
+#include <cnr_hardware_interface/posveleff_command_interface.h>
+#include <cnr_hardware_interface/internal/fixed_span.h>
+#include <cnr_hardware_interface/internal/resource_index.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief RobotHW of a robot with N joints, N known at compile time.
+ *
+ * The joints are stored in m_buffer (so the command channel, the shared-memory state and the black box work as for
+ * any RobotHW), but they are accessed through FixedSpan<double, N>: the bulk copies and the limits have a constant
+ * trip count, and the indexes can be checked at compile time (e.g. position().get<2>()).
+ * The standard joint interfaces (state, position, velocity, effort, velocity-effort, position-velocity-effort) are
+ * registered as usual, so any ros_control controller works unchanged.
+ *
+ * Call initJoints() in doInit() of the derived class.
+ */
+template<std::size_t N>
+class FixedDofRobotHW : public RobotHW
+{
+  static_assert(N > 0, "FixedDofRobotHW requires at least a joint");
+
+public:
+  static constexpr std::size_t kDof = N;
+  typedef std::array<double, N>      Array;
+  typedef std::bitset<N>             Mask;
+  typedef FixedSpan<double, N>       Span;
+  typedef FixedSpan<const double, N> ConstSpan;
+
+  FixedDofRobotHW() = default;
+  virtual ~FixedDofRobotHW() = default;
+
+  Span position()        { return Span(m_buffer.position().data()); }
+  Span velocity()        { return Span(m_buffer.velocity().data()); }
+  Span effort()          { return Span(m_buffer.effort().data()); }
+  Span commandPosition() { return Span(m_buffer.commandPosition().data()); }
+  Span commandVelocity() { return Span(m_buffer.commandVelocity().data()); }
+  Span commandEffort()   { return Span(m_buffer.commandEffort().data()); }
+
+  ConstSpan position() const        { return ConstSpan(m_buffer.position().data()); }
+  ConstSpan velocity() const        { return ConstSpan(m_buffer.velocity().data()); }
+  ConstSpan effort() const          { return ConstSpan(m_buffer.effort().data()); }
+  ConstSpan commandPosition() const { return ConstSpan(m_buffer.commandPosition().data()); }
+  ConstSpan commandVelocity() const { return ConstSpan(m_buffer.commandVelocity().data()); }
+  ConstSpan commandEffort() const   { return ConstSpan(m_buffer.commandEffort().data()); }
+
+  /**
+   * @brief RT-safe: the joints claimed by the controllers, e.g. for doCheckForConflict() or doDoSwitch().
+   * The resources that are not joints of the robot are ignored.
+   */
+  Mask claimedJoints(const std::list<hardware_interface::ControllerInfo>& info) const
+  {
+    Mask claimed;
+    for (const hardware_interface::ControllerInfo& controller : info)
+    {
+      for (const hardware_interface::InterfaceResources& res : controller.claimed_resources)
+      {
+        for (const std::string& name : res.resources)
+        {
+          const int i = m_fixed_joint_index.find(name);
+          if (i >= 0)
+          {
+            claimed.set(static_cast<std::size_t>(i));
+          }
+        }
+      }
+    }
+    return claimed;
+  }
+
+  /**
+   * @brief RT-safe: the commanded position follows the measured one, and the velocity and effort commands are zero
+   */
+  void holdPosition()
+  {
+    commandPosition().assign(position());
+    commandVelocity().fill(0.0);
+    commandEffort().fill(0.0);
+  }
+
+protected:
+  /**
+   * @brief Not RT-safe, to be called in doInit(). It sizes m_buffer, sets the resource names and registers the
+   * standard joint interfaces. The force-torque interfaces of the sensors are registered by the derived class,
+   * e.g. with registerBufferInterface().
+   * @return false if the number of joint names is not N
+   */
+  bool initJoints(const std::vector<std::string>& joint_names,
+                  const std::vector<std::string>& analog_names = std::vector<std::string>(),
+                  const std::vector<std::string>& digital_names = std::vector<std::string>(),
+                  const std::vector<std::string>& ft_names = std::vector<std::string>())
+  {
+    if (joint_names.size() != N)
+    {
+      CNR_ERROR(m_logger, "The robot has " << N << " joints, while " << joint_names.size() << " names are given");
+      return false;
+    }
+    m_buffer.resize(joint_names, analog_names, digital_names, ft_names);
+    m_fixed_joint_index.assign(joint_names);
+
+    std::vector<std::string> resources = joint_names;
+    resources.insert(resources.end(), analog_names.begin(), analog_names.end());
+    resources.insert(resources.end(), digital_names.begin(), digital_names.end());
+    resources.insert(resources.end(), ft_names.begin(), ft_names.end());
+    setResourceNames(resources);
+
+    registerBufferInterface(m_fixed_js);
+    registerBufferInterface(m_fixed_pj);
+    registerBufferInterface(m_fixed_vj);
+    registerBufferInterface(m_fixed_ej);
+    registerBufferInterface(m_fixed_vej);
+    registerBufferInterface(m_fixed_pvej);
+    return true;
+  }
+
+private:
+  cnr_hardware_interface::ResourceIndex       m_fixed_joint_index;
+  hardware_interface::JointStateInterface     m_fixed_js;
+  hardware_interface::PositionJointInterface  m_fixed_pj;
+  hardware_interface::VelocityJointInterface  m_fixed_vj;
+  hardware_interface::EffortJointInterface    m_fixed_ej;
+  hardware_interface::VelEffJointInterface    m_fixed_vej;
+  hardware_interface::PosVelEffJointInterface m_fixed_pvej;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_FIXED_DOF_ROBOT_HW_H
@@ -35,6 +35,7 @@
 #ifndef CNR_HARDWARE_INTERFACE_FORCE_TORQUE_COMMAND_INTERFACE_H
 #define CNR_HARDWARE_INTERFACE_FORCE_TORQUE_COMMAND_INTERFACE_H
 
+#include <cassert>
 #include <string>
 #include <cnr_hardware_interface/force_torque_state_interface.h>
 
@@ -68,14 +69,14 @@ public:
     }
   }
 
-  void setForce(double* force)
+  void setForce(const double* force)
   {
     assert(output_force_);
     output_force_[0] = force[0];
     output_force_[1] = force[1];
     output_force_[2] = force[2];
   }
-  void setTorque(double* torque)
+  void setTorque(const double* torque)
   {
     assert(output_torque_);
     output_torque_[0] = torque[0];
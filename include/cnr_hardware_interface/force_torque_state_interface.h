@@ -71,11 +71,19 @@ public:
       torque_(torque)
   {}
 
-  std::string getName()     const
+  const std::string& getName() const&
   {
     return name_;
   }
-  std::string getFrameId()  const
+  std::string getName() const&&
+  {
+    return name_;
+  }
+  const std::string& getFrameId() const&
+  {
+    return frame_id_;
+  }
+  std::string getFrameId() const&&
   {
     return frame_id_;
   }
@@ -0,0 +1,370 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_HARDWARE_BUFFER_H
+#define CNR_HARDWARE_INTERFACE_HARDWARE_BUFFER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <cnr_hardware_interface/veleff_command_interface.h>
+#include <cnr_hardware_interface/posveleff_command_interface.h>
+#include <cnr_hardware_interface/analog_command_interface.h>
+#include <cnr_hardware_interface/digital_command_interface.h>
+#include <cnr_hardware_interface/force_torque_command_interface.h>
+#include <cnr_hardware_interface/internal/resource_index.h>
+
+namespace cnr_hardware_interface
+{
+
+static constexpr std::size_t kCacheLineSize = 64;
+
+/**
+ * @brief A contiguous array, aligned to the cache line. Its size is padded to a multiple of the cache line, so that
+ * two columns never share a line. The storage is (re)allocated only by resize(): the pointers to the elements are
+ * stable since then.
+ */
+template<typename T>
+class AlignedColumn
+{
+  static_assert(std::is_trivially_copyable<T>::value, "AlignedColumn requires a trivially copyable type");
+
+public:
+  AlignedColumn() : size_(0), data_(nullptr) {}
+  AlignedColumn(const AlignedColumn&) = delete;
+  AlignedColumn& operator=(const AlignedColumn&) = delete;
+
+  void resize(const std::size_t n, const T& value = T())
+  {
+    const std::size_t bytes = ((n * sizeof(T) + kCacheLineSize - 1) / kCacheLineSize) * kCacheLineSize;
+    std::size_t space = bytes + kCacheLineSize;
+    raw_.reset(new unsigned char[space]);
+    void* p = raw_.get();
+    data_ = static_cast<T*>(std::align(kCacheLineSize, bytes, p, space));
+    size_ = n;
+    std::fill(data_, data_ + size_, value);
+  }
+
+  std::size_t size() const { return size_; }
+  T*          data() { return data_; }
+  const T*    data() const { return data_; }
+  T*          begin() { return data_; }
+  T*          end() { return data_ + size_; }
+  const T*    begin() const { return data_; }
+  const T*    end() const { return data_ + size_; }
+
+  T& operator[](const std::size_t i) { return data_[i]; }
+  const T& operator[](const std::size_t i) const { return data_[i]; }
+
+private:
+  std::size_t                      size_;
+  std::unique_ptr<unsigned char[]> raw_;
+  T*                               data_;
+};
+
+/**
+ * @brief Structure-of-arrays storage of the joint states and commands, of the analog and digital channels, and of
+ * the wrenches of the force-torque sensors.
+ *
+ * Each quantity is a separate cache-aligned column, indexed as the names given to resize(): doRead()/doWrite()
+ * can copy a whole column at once, and the handles created by the buffer point into the columns, so a controller
+ * that walks all the joints streams contiguous memory. The wrench columns are 6 doubles wide per sensor (force x,
+ * y, z, then torque x, y, z), so that the handles of the sensor point to two consecutive triplets.
+ *
+ * resize() is not RT-safe and invalidates the handles: call it once, in doInit(), before registering the handles.
+ */
+class HardwareBuffer
+{
+public:
+  HardwareBuffer() = default;
+  HardwareBuffer(const HardwareBuffer&) = delete;
+  HardwareBuffer& operator=(const HardwareBuffer&) = delete;
+
+  static constexpr std::size_t kWrenchSize = 6;  // doubles per force-torque sensor in the wrench columns
+
+  /**
+   * @param ft_frame_ids the frame of each force-torque sensor, the name of the sensor if empty
+   */
+  void resize(const std::vector<std::string>& joint_names,
+              const std::vector<std::string>& analog_names = std::vector<std::string>(),
+              const std::vector<std::string>& digital_names = std::vector<std::string>(),
+              const std::vector<std::string>& ft_names = std::vector<std::string>(),
+              const std::vector<std::string>& ft_frame_ids = std::vector<std::string>())
+  {
+    joint_names_   = joint_names;
+    analog_names_  = analog_names;
+    digital_names_ = digital_names;
+    ft_names_      = ft_names;
+    ft_frame_ids_  = ft_frame_ids.size() == ft_names.size() ? ft_frame_ids : ft_names;
+    joint_index_.assign(joint_names_);
+    analog_index_.assign(analog_names_);
+    digital_index_.assign(digital_names_);
+    ft_index_.assign(ft_names_);
+
+    for (AlignedColumn<double>* c : { &position_, &velocity_, &effort_,
+                                      &command_position_, &command_velocity_, &command_effort_ })
+    {
+      c->resize(joint_names_.size(), 0.0);
+    }
+    command_seq_.resize(joint_names_.size(), 0);
+    analog_value_.resize(analog_names_.size(), 0.0);
+    analog_command_.resize(analog_names_.size(), 0.0);
+    digital_value_.resize(digital_names_.size(), false);
+    digital_command_.resize(digital_names_.size(), false);
+    wrench_.resize(kWrenchSize * ft_names_.size(), 0.0);
+    wrench_command_.resize(kWrenchSize * ft_names_.size(), 0.0);
+  }
+
+  // ======================================================= names
+  const std::vector<std::string>& jointNames() const { return joint_names_; }
+  const std::vector<std::string>& analogNames() const { return analog_names_; }
+  const std::vector<std::string>& digitalNames() const { return digital_names_; }
+  const std::vector<std::string>& forceTorqueNames() const { return ft_names_; }
+  const std::vector<std::string>& forceTorqueFrameIds() const { return ft_frame_ids_; }
+  std::size_t jointNumber() const { return joint_names_.size(); }
+
+  /**
+   * @return the index of the joint in the columns, -1 if not found
+   */
+  int jointIndex(const std::string& name) const { return joint_index_.find(name); }
+  int analogIndex(const std::string& name) const { return analog_index_.find(name); }
+  int digitalIndex(const std::string& name) const { return digital_index_.find(name); }
+  int forceTorqueIndex(const std::string& name) const { return ft_index_.find(name); }
+
+  // ======================================================= columns
+  AlignedColumn<double>& position() { return position_; }
+  AlignedColumn<double>& velocity() { return velocity_; }
+  AlignedColumn<double>& effort() { return effort_; }
+  AlignedColumn<double>& commandPosition() { return command_position_; }
+  AlignedColumn<double>& commandVelocity() { return command_velocity_; }
+  AlignedColumn<double>& commandEffort() { return command_effort_; }
+  AlignedColumn<double>& analogValue() { return analog_value_; }
+  AlignedColumn<double>& analogCommand() { return analog_command_; }
+  AlignedColumn<bool>&   digitalValue() { return digital_value_; }
+  AlignedColumn<bool>&   digitalCommand() { return digital_command_; }
+  AlignedColumn<double>& wrench() { return wrench_; }
+  AlignedColumn<double>& wrenchCommand() { return wrench_command_; }
+
+  const AlignedColumn<double>& position() const { return position_; }
+  const AlignedColumn<double>& velocity() const { return velocity_; }
+  const AlignedColumn<double>& effort() const { return effort_; }
+  const AlignedColumn<double>& commandPosition() const { return command_position_; }
+  const AlignedColumn<double>& commandVelocity() const { return command_velocity_; }
+  const AlignedColumn<double>& commandEffort() const { return command_effort_; }
+  const AlignedColumn<double>& analogValue() const { return analog_value_; }
+  const AlignedColumn<double>& analogCommand() const { return analog_command_; }
+  const AlignedColumn<bool>&   digitalValue() const { return digital_value_; }
+  const AlignedColumn<bool>&   digitalCommand() const { return digital_command_; }
+  const AlignedColumn<double>& wrench() const { return wrench_; }
+  const AlignedColumn<double>& wrenchCommand() const { return wrench_command_; }
+
+  /**
+   * @brief Per-joint counters, incremented by the VelEffJointHandle/PosVelEffJointHandle at each command
+   */
+  const AlignedColumn<uint64_t>& commandSeq() const { return command_seq_; }
+
+  // ======================================================= handle factories
+  hardware_interface::JointStateHandle jointStateHandle(const std::size_t i) const
+  {
+    return hardware_interface::JointStateHandle(joint_names_.at(i), &position_[i], &velocity_[i], &effort_[i]);
+  }
+  hardware_interface::JointHandle positionHandle(const std::size_t i)
+  {
+    return hardware_interface::JointHandle(jointStateHandle(i), &command_position_[i]);
+  }
+  hardware_interface::JointHandle velocityHandle(const std::size_t i)
+  {
+    return hardware_interface::JointHandle(jointStateHandle(i), &command_velocity_[i]);
+  }
+  hardware_interface::JointHandle effortHandle(const std::size_t i)
+  {
+    return hardware_interface::JointHandle(jointStateHandle(i), &command_effort_[i]);
+  }
+  hardware_interface::VelEffJointHandle velEffHandle(const std::size_t i)
+  {
+    return hardware_interface::VelEffJointHandle(jointStateHandle(i), &command_velocity_[i], &command_effort_[i],
+                                                 &command_seq_[i]);
+  }
+  hardware_interface::PosVelEffJointHandle posVelEffHandle(const std::size_t i)
+  {
+    return hardware_interface::PosVelEffJointHandle(jointStateHandle(i), &command_position_[i],
+                                                    &command_velocity_[i], &command_effort_[i], &command_seq_[i]);
+  }
+  hardware_interface::AnalogStateHandle analogStateHandle(const std::size_t i) const
+  {
+    return hardware_interface::AnalogStateHandle(analog_names_.at(i), &analog_value_[i]);
+  }
+  hardware_interface::AnalogHandle analogHandle(const std::size_t i)
+  {
+    return hardware_interface::AnalogHandle(analogStateHandle(i), &analog_command_[i]);
+  }
+  hardware_interface::DigitalStateHandle digitalStateHandle(const std::size_t i) const
+  {
+    return hardware_interface::DigitalStateHandle(digital_names_.at(i), &digital_value_[i]);
+  }
+  hardware_interface::DigitalHandle digitalHandle(const std::size_t i)
+  {
+    return hardware_interface::DigitalHandle(digitalStateHandle(i), &digital_command_[i]);
+  }
+  hardware_interface::ForceTorqueStateHandle forceTorqueStateHandle(const std::size_t i) const
+  {
+    return hardware_interface::ForceTorqueStateHandle(ft_names_.at(i), ft_frame_ids_.at(i), &wrench_[kWrenchSize * i],
+                                                      &wrench_[kWrenchSize * i + 3]);
+  }
+  hardware_interface::ForceTorqueHandle forceTorqueHandle(const std::size_t i)
+  {
+    return hardware_interface::ForceTorqueHandle(forceTorqueStateHandle(i), &wrench_command_[kWrenchSize * i],
+                                                 &wrench_command_[kWrenchSize * i + 3]);
+  }
+
+  // ======================================================= registration of all the handles in an interface
+  void registerHandles(hardware_interface::JointStateInterface& iface) const
+  {
+    for (std::size_t i = 0; i < joint_names_.size(); i++)
+    {
+      iface.registerHandle(jointStateHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::PositionJointInterface& iface)
+  {
+    for (std::size_t i = 0; i < joint_names_.size(); i++)
+    {
+      iface.registerHandle(positionHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::VelocityJointInterface& iface)
+  {
+    for (std::size_t i = 0; i < joint_names_.size(); i++)
+    {
+      iface.registerHandle(velocityHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::EffortJointInterface& iface)
+  {
+    for (std::size_t i = 0; i < joint_names_.size(); i++)
+    {
+      iface.registerHandle(effortHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::VelEffJointInterface& iface)
+  {
+    for (std::size_t i = 0; i < joint_names_.size(); i++)
+    {
+      iface.registerHandle(velEffHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::PosVelEffJointInterface& iface)
+  {
+    for (std::size_t i = 0; i < joint_names_.size(); i++)
+    {
+      iface.registerHandle(posVelEffHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::AnalogStateInterface& iface) const
+  {
+    for (std::size_t i = 0; i < analog_names_.size(); i++)
+    {
+      iface.registerHandle(analogStateHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::AnalogCommandInterface& iface)
+  {
+    for (std::size_t i = 0; i < analog_names_.size(); i++)
+    {
+      iface.registerHandle(analogHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::DigitalStateInterface& iface) const
+  {
+    for (std::size_t i = 0; i < digital_names_.size(); i++)
+    {
+      iface.registerHandle(digitalStateHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::DigitalCommandInterface& iface)
+  {
+    for (std::size_t i = 0; i < digital_names_.size(); i++)
+    {
+      iface.registerHandle(digitalHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::ForceTorqueStateInterface& iface) const
+  {
+    for (std::size_t i = 0; i < ft_names_.size(); i++)
+    {
+      iface.registerHandle(forceTorqueStateHandle(i));
+    }
+  }
+  void registerHandles(hardware_interface::ForceTorqueInterface& iface)
+  {
+    for (std::size_t i = 0; i < ft_names_.size(); i++)
+    {
+      iface.registerHandle(forceTorqueHandle(i));
+    }
+  }
+
+private:
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> analog_names_;
+  std::vector<std::string> digital_names_;
+  std::vector<std::string> ft_names_;
+  std::vector<std::string> ft_frame_ids_;
+  ResourceIndex            joint_index_;
+  ResourceIndex            analog_index_;
+  ResourceIndex            digital_index_;
+  ResourceIndex            ft_index_;
+
+  AlignedColumn<double>    position_;
+  AlignedColumn<double>    velocity_;
+  AlignedColumn<double>    effort_;
+  AlignedColumn<double>    command_position_;
+  AlignedColumn<double>    command_velocity_;
+  AlignedColumn<double>    command_effort_;
+  AlignedColumn<double>    analog_value_;
+  AlignedColumn<double>    analog_command_;
+  AlignedColumn<bool>      digital_value_;
+  AlignedColumn<bool>      digital_command_;
+  AlignedColumn<double>    wrench_;
+  AlignedColumn<double>    wrench_command_;
+  AlignedColumn<uint64_t>  command_seq_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_HARDWARE_BUFFER_H
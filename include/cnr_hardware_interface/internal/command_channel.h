@@ -0,0 +1,153 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_COMMAND_CHANNEL_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_COMMAND_CHANNEL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <cnr_hardware_interface/hardware_buffer.h>
+#include <cnr_hardware_interface/internal/mailbox.h>
+#include <cnr_hardware_interface/internal/phase_timing.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief All the commands of a cycle, ordered as the columns of the HardwareBuffer
+ */
+struct CommandFrame
+{
+  uint64_t             seq;       // 0 if never published
+  uint64_t             stamp_ns;
+  std::vector<double>  position;
+  std::vector<double>  velocity;
+  std::vector<double>  effort;
+  std::vector<double>  analog;
+  std::vector<uint8_t> digital;
+  std::vector<double>  wrench;    // HardwareBuffer::kWrenchSize values (force, then torque) per force-torque sensor
+};
+
+/**
+ * @brief It moves the whole command of a cycle from the update thread to the thread that talks with the hardware.
+ *
+ * The update thread publishes a frame per cycle (RobotHW::write() does it, when the channel is enabled), and the
+ * consumer (doWrite(), or a bus I/O thread of the driver) fetches the last published frame: it is always a
+ * consistent snapshot, never mixed with the commands of the following cycle. The frames are preallocated by
+ * resize(), therefore publish() and fetch() are RT-safe. There must be a single producer and a single consumer.
+ */
+class CommandChannel
+{
+public:
+  CommandChannel() : seq_(0) {}
+  CommandChannel(const CommandChannel&) = delete;
+  CommandChannel& operator=(const CommandChannel&) = delete;
+
+  /**
+   * @brief Not RT-safe. It sizes the frames as the buffer
+   */
+  void resize(const HardwareBuffer& buffer)
+  {
+    CommandFrame init;
+    init.seq      = 0;
+    init.stamp_ns = 0;
+    init.position.assign(buffer.jointNumber(), 0.0);
+    init.velocity.assign(buffer.jointNumber(), 0.0);
+    init.effort.assign(buffer.jointNumber(), 0.0);
+    init.analog.assign(buffer.analogNames().size(), 0.0);
+    init.digital.assign(buffer.digitalNames().size(), 0);
+    init.wrench.assign(HardwareBuffer::kWrenchSize * buffer.forceTorqueNames().size(), 0.0);
+    mailbox_.reset(new Mailbox<CommandFrame>(init));
+    seq_ = 0;
+  }
+
+  bool initialized() const
+  {
+    return mailbox_ != nullptr;
+  }
+
+  // ======================================================= producer side
+  /**
+   * @brief It copies the command columns of the buffer in a frame, and publishes it
+   */
+  void publish(const HardwareBuffer& buffer)
+  {
+    CommandFrame& frame = mailbox_->back();
+    std::copy(buffer.commandPosition().begin(), buffer.commandPosition().end(), frame.position.begin());
+    std::copy(buffer.commandVelocity().begin(), buffer.commandVelocity().end(), frame.velocity.begin());
+    std::copy(buffer.commandEffort().begin(), buffer.commandEffort().end(), frame.effort.begin());
+    std::copy(buffer.analogCommand().begin(), buffer.analogCommand().end(), frame.analog.begin());
+    std::copy(buffer.digitalCommand().begin(), buffer.digitalCommand().end(), frame.digital.begin());
+    std::copy(buffer.wrenchCommand().begin(), buffer.wrenchCommand().end(), frame.wrench.begin());
+    publish();
+  }
+
+  /**
+   * @brief To fill the frame by hand: write back(), then publish()
+   */
+  CommandFrame& back()
+  {
+    return mailbox_->back();
+  }
+  void publish()
+  {
+    CommandFrame& frame = mailbox_->back();
+    frame.seq      = ++seq_;
+    frame.stamp_ns = monotonicNs();
+    mailbox_->publish();
+  }
+
+  // ======================================================= consumer side
+  /**
+   * @return true if a new frame has been published since the last fetch(). The frame is then in front()
+   */
+  bool fetch()
+  {
+    return mailbox_->fetch();
+  }
+  const CommandFrame& front() const
+  {
+    return mailbox_->front();
+  }
+
+private:
+  std::unique_ptr<Mailbox<CommandFrame>> mailbox_;
+  uint64_t                               seq_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_COMMAND_CHANNEL_H
@@ -0,0 +1,333 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_COMMAND_LIMITS_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_COMMAND_LIMITS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <cnr_hardware_interface/hardware_buffer.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Enforcement of the joint limits on the commands of a HardwareBuffer, and watchdog of the command refresh.
+ *
+ * The limits are loaded once in contiguous arrays, with a per-joint mask of the limits actually set (the package is
+ * built with -ffast-math in Release, so infinity cannot be used as "no limit"). A command that is not finite (NaN
+ * or inf, checked on the bit pattern for the same reason) is a fault: all the commands of the joint are replaced by
+ * a hold, i.e. the last valid position command (the measured position if none), and zero velocity and effort. A
+ * position command is recorded only when the position column differs from the value left by the previous apply() or
+ * check(), so that the 0.0 left in the column of a velocity or effort controlled joint is never taken as a command.
+ *
+ * The watchdog checks the command counters of the buffer (see HardwareBuffer::commandSeq()): a joint is watched
+ * since its first command, and it is stale if no command arrives for more than 'cycles' consecutive checks. A stale
+ * joint is held at the position measured when it became stale, up to its next command. disarm() stops watching all
+ * the joints, e.g. when the controllers are switched. All the methods but resize() are RT-safe.
+ */
+class CommandLimiter
+{
+public:
+  CommandLimiter()
+    : watchdog_cycles_(0), stale_joint_(-1), invalid_joint_(-1), held_joints_(0), saturations_(0), stale_events_(0),
+      invalid_events_(0)
+  {
+  }
+
+  void resize(const std::size_t n)
+  {
+    min_position_.assign(n, 0.0);
+    max_position_.assign(n, 0.0);
+    max_velocity_.assign(n, 0.0);
+    max_effort_.assign(n, 0.0);
+    has_position_.assign(n, 0);
+    has_velocity_.assign(n, 0);
+    has_effort_.assign(n, 0);
+    last_position_.assign(n, 0.0);
+    has_last_.assign(n, 0);
+    invalid_.assign(n, 0);
+    out_position_.assign(n, 0.0);
+    last_seq_.assign(n, 0);
+    stale_cycles_.assign(n, 0);
+    armed_.assign(n, 0);
+    held_.assign(n, 0);
+    hold_position_.assign(n, 0.0);
+    held_joints_.store(0, std::memory_order_relaxed);
+  }
+
+  std::size_t size() const
+  {
+    return min_position_.size();
+  }
+
+  void setPositionLimits(const std::size_t i, const double min_position, const double max_position)
+  {
+    min_position_.at(i) = min_position;
+    max_position_.at(i) = max_position;
+    has_position_.at(i) = 1;
+  }
+  void setVelocityLimit(const std::size_t i, const double max_velocity)
+  {
+    max_velocity_.at(i) = std::abs(max_velocity);
+    has_velocity_.at(i) = 1;
+  }
+  void setEffortLimit(const std::size_t i, const double max_effort)
+  {
+    max_effort_.at(i) = std::abs(max_effort);
+    has_effort_.at(i) = 1;
+  }
+  /**
+   * @param cycles 0 disables the watchdog
+   */
+  void setWatchdog(const uint32_t cycles)
+  {
+    watchdog_cycles_ = cycles;
+  }
+  uint32_t watchdogCycles() const
+  {
+    return watchdog_cycles_;
+  }
+
+  /**
+   * @brief The non-finite commands are replaced by the hold (see invalidJoint()), then the limits are applied
+   * @return the number of commands that have been saturated
+   */
+  std::size_t apply(HardwareBuffer& buffer)
+  {
+    const std::size_t n = std::min(size(), buffer.jointNumber());
+    double* pos = buffer.commandPosition().data();
+    double* vel = buffer.commandVelocity().data();
+    double* eff = buffer.commandEffort().data();
+    const double* measured = buffer.position().data();
+    invalid_joint_ = -1;
+    std::size_t invalid = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+      invalid_[i] = 0;
+      if (!isFinite(pos[i]) || !isFinite(vel[i]) || !isFinite(eff[i]))
+      {
+        invalid_[i] = 1;
+        const double hold = has_last_[i] ? last_position_[i] : measured[i];
+        pos[i] = isFinite(hold) ? hold : 0.0;
+        vel[i] = 0.0;
+        eff[i] = 0.0;
+        if (invalid == 0)
+        {
+          invalid_joint_ = static_cast<int>(i);
+        }
+        invalid++;
+      }
+    }
+
+    std::size_t saturated = 0;
+    saturated += clamp(pos, min_position_.data(), max_position_.data(), has_position_.data(), n, false);
+    saturated += clamp(vel, max_velocity_.data(), max_velocity_.data(), has_velocity_.data(), n, true);
+    saturated += clamp(eff, max_effort_.data(), max_effort_.data(), has_effort_.data(), n, true);
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (!invalid_[i] && pos[i] != out_position_[i])
+      {
+        last_position_[i] = pos[i];
+        has_last_[i]      = 1;
+      }
+      out_position_[i] = pos[i];
+    }
+    saturations_.store(saturations_.load(std::memory_order_relaxed) + saturated, std::memory_order_relaxed);
+    if (invalid > 0)
+    {
+      invalid_events_.store(invalid_events_.load(std::memory_order_relaxed) + invalid, std::memory_order_relaxed);
+    }
+    return saturated;
+  }
+
+  /**
+   * @brief The commands of the stale joints are replaced by the hold, up to the next command of the joint
+   * @return false if a watched joint is stale at this check (see staleJoint()). The joint is not watched anymore,
+   * up to its next command.
+   */
+  bool check(HardwareBuffer& buffer)
+  {
+    if (watchdog_cycles_ == 0)
+    {
+      return true;
+    }
+    const std::size_t n = std::min(size(), buffer.jointNumber());
+    const uint64_t* seq = buffer.commandSeq().data();
+    const double* measured = buffer.position().data();
+    bool ok = true;
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (seq[i] != last_seq_[i])
+      {
+        last_seq_[i]     = seq[i];
+        stale_cycles_[i] = 0;
+        armed_[i]        = 1;
+        if (held_[i])
+        {
+          held_[i] = 0;
+          held_joints_.fetch_sub(1, std::memory_order_relaxed);
+        }
+      }
+      else if (armed_[i] && ++stale_cycles_[i] > watchdog_cycles_)
+      {
+        armed_[i]         = 0;
+        held_[i]          = 1;
+        hold_position_[i] = isFinite(measured[i]) ? measured[i] : last_position_[i];
+        held_joints_.fetch_add(1, std::memory_order_relaxed);
+        if (ok)
+        {
+          stale_joint_ = static_cast<int>(i);
+        }
+        ok = false;
+      }
+      if (held_[i])
+      {
+        buffer.commandPosition()[i] = hold_position_[i];
+        out_position_[i]            = hold_position_[i];
+        buffer.commandVelocity()[i] = 0.0;
+        buffer.commandEffort()[i]   = 0.0;
+      }
+    }
+    if (!ok)
+    {
+      stale_events_.store(stale_events_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    return ok;
+  }
+
+  void disarm()
+  {
+    std::fill(armed_.begin(), armed_.end(), 0);
+    std::fill(stale_cycles_.begin(), stale_cycles_.end(), 0);
+  }
+
+  /**
+   * @return the first stale joint of the last failed check(), -1 if none
+   */
+  int staleJoint() const
+  {
+    return stale_joint_;
+  }
+  /**
+   * @return the first joint with a non-finite command at the last apply(), -1 if none
+   */
+  int invalidJoint() const
+  {
+    return invalid_joint_;
+  }
+  /**
+   * @brief Any thread: the joints currently held since stale
+   */
+  uint32_t heldJoints() const
+  {
+    return held_joints_.load(std::memory_order_relaxed);
+  }
+  /**
+   * @brief Any thread: the saturated commands, the stale events and the non-finite commands since the start
+   */
+  uint64_t saturations() const
+  {
+    return saturations_.load(std::memory_order_relaxed);
+  }
+  uint64_t staleEvents() const
+  {
+    return stale_events_.load(std::memory_order_relaxed);
+  }
+  uint64_t invalidEvents() const
+  {
+    return invalid_events_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief NaN and inf have all the exponent bits set. std::isfinite() may be folded to true under -ffinite-math-only
+   */
+  static bool isFinite(const double v)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return (bits & 0x7FF0000000000000ULL) != 0x7FF0000000000000ULL;
+  }
+
+private:
+  static std::size_t clamp(double* v, const double* lo, const double* hi, const uint8_t* has, const std::size_t n,
+                           const bool symmetric)
+  {
+    std::size_t saturated = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (!has[i])
+      {
+        continue;
+      }
+      const double l = symmetric ? -lo[i] : lo[i];
+      const double c = std::min(std::max(v[i], l), hi[i]);
+      saturated += (c != v[i]) ? 1 : 0;
+      v[i] = c;
+    }
+    return saturated;
+  }
+
+  std::vector<double>   min_position_;
+  std::vector<double>   max_position_;
+  std::vector<double>   max_velocity_;
+  std::vector<double>   max_effort_;
+  std::vector<uint8_t>  has_position_;
+  std::vector<uint8_t>  has_velocity_;
+  std::vector<uint8_t>  has_effort_;
+  std::vector<double>   last_position_;  // last valid position command, after the limits
+  std::vector<uint8_t>  has_last_;
+  std::vector<uint8_t>  invalid_;
+  std::vector<double>   out_position_;   // position command left in the buffer by the last apply() or check()
+  std::vector<uint64_t> last_seq_;
+  std::vector<uint32_t> stale_cycles_;
+  std::vector<uint8_t>  armed_;
+  std::vector<uint8_t>  held_;
+  std::vector<double>   hold_position_;
+  uint32_t              watchdog_cycles_;
+  int                   stale_joint_;
+  int                   invalid_joint_;
+  std::atomic<uint32_t> held_joints_;
+  std::atomic<uint64_t> saturations_;
+  std::atomic<uint64_t> stale_events_;
+  std::atomic<uint64_t> invalid_events_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_COMMAND_LIMITS_H
@@ -0,0 +1,270 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_CONTROLLER_REGISTRY_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_CONTROLLER_REGISTRY_H
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <hardware_interface/robot_hw.h>
+#include <hardware_interface/controller_info.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Index of the active controllers of the RobotHW, and of the controllers involved in the last switch.
+ *
+ * The controllers are stored in a std::list (the RobotHW::m_active_controllers), whose iterators are stable, and
+ * the registry maps each name to its element in the list. Therefore lookup, insertion and removal are O(1), and the
+ * list must not be modified but through the registry.
+ *
+ * Each controller involved in a switch has its own state: the switch of a controller can be deferred, and then
+ * completed several RT cycles later, while the other controllers are already DONE. The switch table is preallocated
+ * with 'max_switching' slots, and each slot is made of atomics (the hash of the controller name, its state and the
+ * deferred flag): beginSwitch() (non-RT) never reallocates it, and the RT readers never see a partially written slot.
+ */
+class ControllerRegistry
+{
+public:
+  typedef std::list<hardware_interface::ControllerInfo> ControllerList;
+  typedef hardware_interface::RobotHW::SwitchState      SwitchState;
+
+  explicit ControllerRegistry(ControllerList& active, const std::size_t max_switching = 64)
+    : active_(active), switching_(max_switching), switching_size_(0), pending_(0)
+  {
+  }
+
+  ControllerRegistry(const ControllerRegistry&) = delete;
+  ControllerRegistry& operator=(const ControllerRegistry&) = delete;
+
+  bool isActive(const std::string& name) const
+  {
+    return entries_.find(name) != entries_.end();
+  }
+
+  /**
+   * @return false if the controller is already active
+   */
+  bool activate(const hardware_interface::ControllerInfo& info)
+  {
+    if (isActive(info.name))
+    {
+      return false;
+    }
+    entries_.emplace(info.name, active_.insert(active_.end(), info));
+    return true;
+  }
+
+  /**
+   * @return false if the controller is not active
+   */
+  bool deactivate(const std::string& name)
+  {
+    std::unordered_map<std::string, ControllerList::iterator>::iterator it = entries_.find(name);
+    if (it == entries_.end())
+    {
+      return false;
+    }
+    active_.erase(it->second);
+    entries_.erase(it);
+    return true;
+  }
+
+  std::size_t size() const
+  {
+    return entries_.size();
+  }
+
+  // ======================================================= switch tracking
+  /**
+   * @return the maximum number of controllers of a switch
+   */
+  std::size_t maxSwitching() const
+  {
+    return switching_.size();
+  }
+
+  /**
+   * @brief Called out of the RT loop (prepareSwitch): all the controllers to start or stop are marked ONGOING
+   * @return false if the controllers are more than maxSwitching(). The last switch is then forgotten.
+   */
+  bool beginSwitch(const ControllerList& start_list, const ControllerList& stop_list)
+  {
+    switching_size_.store(0, std::memory_order_release);
+    pending_ = 0;
+    std::size_t n = 0;
+    for (const ControllerList* list : { &start_list, &stop_list })
+    {
+      for (const hardware_interface::ControllerInfo& ctrl : *list)
+      {
+        const std::size_t hash = std::hash<std::string>()(ctrl.name);
+        if (indexOf(hash, n) >= 0)
+        {
+          continue;
+        }
+        if (n == switching_.size())
+        {
+          return false;
+        }
+        switching_[n].hash.store(hash, std::memory_order_relaxed);
+        switching_[n].state.store(SwitchState::ONGOING, std::memory_order_relaxed);
+        switching_[n].deferred.store(false, std::memory_order_relaxed);
+        n++;
+      }
+    }
+    switching_size_.store(n, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief RT-safe. The switch of the controller is not concluded by endSwitch(), but by completeSwitch()
+   * @return false if the controller is not involved in the last switch, or if it has been already concluded
+   */
+  bool deferSwitch(const std::string& name)
+  {
+    const int i = indexOf(name);
+    if (i < 0 || switching_[i].state.load(std::memory_order_acquire) != SwitchState::ONGOING)
+    {
+      return false;
+    }
+    if (!switching_[i].deferred.exchange(true, std::memory_order_acq_rel))
+    {
+      pending_++;
+    }
+    return true;
+  }
+
+  /**
+   * @brief RT-safe. It concludes all the controllers of the switch that have not been deferred.
+   * If the result is ERROR, also the deferred ones are concluded with ERROR.
+   */
+  void endSwitch(const SwitchState& result)
+  {
+    const std::size_t n = switching_size_.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (!switching_[i].deferred.load(std::memory_order_acquire) || result == SwitchState::ERROR)
+      {
+        switching_[i].state.store(result, std::memory_order_release);
+      }
+    }
+    if (result == SwitchState::ERROR)
+    {
+      pending_ = 0;
+    }
+  }
+
+  /**
+   * @brief RT-safe. It concludes a deferred switch
+   * @return false if the controller switch was not deferred, or it has been already concluded
+   */
+  bool completeSwitch(const std::string& name, const SwitchState& result)
+  {
+    const int i = indexOf(name);
+    if (i < 0 || !switching_[i].deferred.load(std::memory_order_acquire)
+        || switching_[i].state.load(std::memory_order_acquire) != SwitchState::ONGOING)
+    {
+      return false;
+    }
+    switching_[i].state.store(result, std::memory_order_release);
+    pending_--;
+    return true;
+  }
+
+  /**
+   * @return the number of deferred switches not yet concluded
+   */
+  std::size_t pendingSwitches() const
+  {
+    return pending_;
+  }
+
+  /**
+   * @brief RT-safe
+   * @return false if the controller is not involved in the last switch
+   */
+  bool switchState(const std::string& name, SwitchState& state) const
+  {
+    const int i = indexOf(name);
+    if (i < 0)
+    {
+      return false;
+    }
+    state = switching_[i].state.load(std::memory_order_acquire);
+    return true;
+  }
+
+private:
+  struct Switching
+  {
+    Switching() : hash(0), state(SwitchState::ONGOING), deferred(false) {}
+    std::atomic<std::size_t> hash;  // of the controller name
+    std::atomic<SwitchState> state;
+    std::atomic<bool>        deferred;
+  };
+
+  /**
+   * @return the slot of the controller in the last switch, -1 if not found
+   */
+  int indexOf(const std::string& name) const
+  {
+    return indexOf(std::hash<std::string>()(name), switching_size_.load(std::memory_order_acquire));
+  }
+  int indexOf(const std::size_t hash, const std::size_t n) const
+  {
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (switching_[i].hash.load(std::memory_order_relaxed) == hash)
+      {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  ControllerList&                                            active_;
+  std::unordered_map<std::string, ControllerList::iterator>  entries_;
+  std::vector<Switching>                                     switching_;
+  std::atomic<std::size_t>                                   switching_size_;
+  std::atomic<std::size_t>                                   pending_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_CONTROLLER_REGISTRY_H
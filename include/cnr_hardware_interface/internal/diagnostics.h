@@ -39,6 +39,7 @@
 #include <algorithm>
 #include <chrono>  //NOLINT
 #include <mutex>  //NOLINT
+#include <atomic>
 #include <cinttypes>
 #include <csignal>
 
@@ -47,26 +48,47 @@
 #include <diagnostic_updater/diagnostic_updater.h>
 #include <rosparam_utilities/rosparam_utilities.h>
 #include <realtime_utilities/circular_buffer.h>
+#include <cnr_hardware_interface/internal/seqlock.h>
+#include <cnr_hardware_interface/internal/running_stats.h>
 
+/**
+ * @brief All the timing statistics of the main thread, returned together by MainThreadSharedData::getStatistics()
+ * The times are in seconds.
+ */
+struct MainThreadStatistics
+{
+  double                                   cycle_time;
+  cnr_hardware_interface::WindowStatistics act_cycle_time;
+  cnr_hardware_interface::WindowStatistics latency_time;
+  cnr_hardware_interface::WindowStatistics calc_time;
+  cnr_hardware_interface::WindowStatistics missed_cycles;
+};
+
+/**
+ * @brief Timing statistics shared between the RT thread (single producer) and the diagnostics (consumers).
+ * The setters update the window statistics incrementally, and publish them through a SeqLock: they neither lock
+ * nor allocate. The getters only copy the last published statistics, and they cost O(1) whatever the window size.
+ */
 class MainThreadSharedData
 {
 private:
-  const int         windows_dim_;
-  std::mutex        mtx_;
-  double            cycle_time_;
-  realtime_utilities::circ_buffer<double>   latency_msr_;
-  realtime_utilities::circ_buffer<double>   cycle_time_msr_;
-  realtime_utilities::circ_buffer<double>   calc_time_;
-  realtime_utilities::circ_buffer<uint32_t> missed_cycles_;
+  typedef cnr_hardware_interface::PublishedWindowStats Window;
+
+  const int           windows_dim_;
+  std::atomic<double> cycle_time_;
+  Window              latency_msr_;
+  Window              cycle_time_msr_;
+  Window              calc_time_;
+  Window              missed_cycles_;
 
 public:
   explicit MainThreadSharedData(const int windows_dim)
     : windows_dim_(windows_dim)
     , cycle_time_(0)
-    , latency_msr_(windows_dim)
-    , cycle_time_msr_(windows_dim)
-    , calc_time_(windows_dim)
-    , missed_cycles_(windows_dim)
+    , latency_msr_(static_cast<std::size_t>(std::max(windows_dim, 1)))
+    , cycle_time_msr_(static_cast<std::size_t>(std::max(windows_dim, 1)))
+    , calc_time_(static_cast<std::size_t>(std::max(windows_dim, 1)))
+    , missed_cycles_(static_cast<std::size_t>(std::max(windows_dim, 1)))
   {
   }
 
@@ -76,97 +98,106 @@ public:
   }
   double   getCycleTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return cycle_time_;
+    return cycle_time_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Snapshot of all the statistics at once (times in seconds)
+   */
+  MainThreadStatistics getStatistics() const
+  {
+    MainThreadStatistics ret;
+    ret.cycle_time     = cycle_time_.load(std::memory_order_relaxed);
+    ret.act_cycle_time = cycle_time_msr_.statistics();
+    ret.latency_time   = latency_msr_.statistics();
+    ret.calc_time      = calc_time_.statistics();
+    ret.missed_cycles  = missed_cycles_.statistics();
+    return ret;
   }
 
   double   getMeanActCycleTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::mean(cycle_time_msr_.get()) * 1e3;
+    return cycle_time_msr_.statistics().mean * 1e3;
   }
   double   getMeanCalcTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::mean(calc_time_.get()) * 1e3;
+    return calc_time_.statistics().mean * 1e3;
   }
   double   getMeanLatencyTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::mean(latency_msr_.get()) * 1e3;
+    return latency_msr_.statistics().mean * 1e3;
   }
   uint32_t getMeanMissedCycles()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::mean(missed_cycles_.get());
+    return static_cast<uint32_t>(missed_cycles_.statistics().mean);
   }
 
   double   getMaxActCycleTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::max(cycle_time_msr_.get()) * 1e3;
+    return cycle_time_msr_.statistics().max * 1e3;
   }
   double   getMaxCalcTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::max(calc_time_.get()) * 1e3;
+    return calc_time_.statistics().max * 1e3;
   }
   double   getMaxLatencyTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::max(latency_msr_.get()) * 1e3;
+    return latency_msr_.statistics().max * 1e3;
   }
   uint32_t getMaxMissedCycles()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::max(missed_cycles_.get());
+    return static_cast<uint32_t>(missed_cycles_.statistics().max);
   }
 
   double   getMinActCycleTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::min(cycle_time_msr_.get()) * 1e3;
+    return cycle_time_msr_.statistics().min * 1e3;
   }
   double   getMinCalcTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::min(calc_time_.get()) * 1e3;
+    return calc_time_.statistics().min * 1e3;
   }
   double   getMinLatencyTime()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::min(latency_msr_.get()) * 1e3;
+    return latency_msr_.statistics().min * 1e3;
   }
   uint32_t getMinMissedCycles()
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return realtime_utilities::min(missed_cycles_.get());
+    return static_cast<uint32_t>(missed_cycles_.statistics().min);
+  }
+
+  double   getJitterActCycleTime()
+  {
+    return cycle_time_msr_.statistics().jitter * 1e3;
+  }
+  double   getJitterCalcTime()
+  {
+    return calc_time_.statistics().jitter * 1e3;
+  }
+  double   getJitterLatencyTime()
+  {
+    return latency_msr_.statistics().jitter * 1e3;
   }
 
   void     setCycleTime(double    v)
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    cycle_time_    = v;
+    cycle_time_.store(v, std::memory_order_relaxed);
   }
   void     setActualCycleTime(double    v)
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    cycle_time_msr_.push_back(v);
+    cycle_time_msr_.push(v);
   }
   void     setLatencyTime(double    v)
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    latency_msr_.push_back(v);
+    latency_msr_.push(v);
   }
   void     setCalcTime(double    v)
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    calc_time_.push_back(v);
+    calc_time_.push(v);
   }
   void     setMissedCycles(uint32_t  v)
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    missed_cycles_.push_back(v);
+    missed_cycles_.push(static_cast<double>(v));
   }
 };
 
@@ -0,0 +1,145 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_FIXED_SPAN_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_FIXED_SPAN_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <type_traits>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief A view of N contiguous elements, with N known at compile time: the loops over the span have a constant
+ * trip count, and the compiler can fully unroll (and vectorize) them. It does not own the storage.
+ */
+template<typename T, std::size_t N>
+class FixedSpan
+{
+public:
+  static constexpr std::size_t kSize = N;
+
+  FixedSpan() : data_(nullptr) {}
+  explicit FixedSpan(T* data) : data_(data) {}
+
+  static constexpr std::size_t size()
+  {
+    return N;
+  }
+  T* data() const
+  {
+    return data_;
+  }
+  T* begin() const
+  {
+    return data_;
+  }
+  T* end() const
+  {
+    return data_ + N;
+  }
+  T& operator[](const std::size_t i) const
+  {
+    return data_[i];
+  }
+
+  /**
+   * @brief Access checked at compile time
+   */
+  template<std::size_t I>
+  T& get() const
+  {
+    static_assert(I < N, "FixedSpan index out of range");
+    return data_[I];
+  }
+
+  template<typename U>
+  void assign(const FixedSpan<U, N>& rhs) const
+  {
+    for (std::size_t i = 0; i < N; i++)
+    {
+      data_[i] = rhs[i];
+    }
+  }
+  template<typename U>
+  void assign(const std::array<U, N>& rhs) const
+  {
+    for (std::size_t i = 0; i < N; i++)
+    {
+      data_[i] = rhs[i];
+    }
+  }
+  void fill(const T& value) const
+  {
+    for (std::size_t i = 0; i < N; i++)
+    {
+      data_[i] = value;
+    }
+  }
+  std::array<typename std::remove_const<T>::type, N> toArray() const
+  {
+    std::array<typename std::remove_const<T>::type, N> ret;
+    for (std::size_t i = 0; i < N; i++)
+    {
+      ret[i] = data_[i];
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Saturate each element in [lower[i], upper[i]]
+   * @return the mask of the saturated elements
+   */
+  std::bitset<N> clamp(const std::array<T, N>& lower, const std::array<T, N>& upper) const
+  {
+    std::bitset<N> saturated;
+    for (std::size_t i = 0; i < N; i++)
+    {
+      const T v = data_[i] < lower[i] ? lower[i] : (data_[i] > upper[i] ? upper[i] : data_[i]);
+      saturated[i] = (v != data_[i]);
+      data_[i] = v;
+    }
+    return saturated;
+  }
+
+private:
+  T* data_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_FIXED_SPAN_H
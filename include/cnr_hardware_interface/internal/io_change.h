@@ -0,0 +1,198 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_IO_CHANGE_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_IO_CHANGE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cnr_hardware_interface/hardware_buffer.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Per-cycle change detection of the digital and analog inputs of a HardwareBuffer.
+ *
+ * update() (RT-safe, called by read()) packs the digital values in 64-channel words and computes the mask of the
+ * channels that toggled since the previous cycle; an analog channel is flagged when it moves more than its
+ * deadband from the last flagged value. The consumers then visit only the flagged channels.
+ * At the first update() all the channels are flagged, so the consumers get the initial values.
+ */
+class IOChangeDetector
+{
+public:
+  IOChangeDetector() : first_(true) {}
+
+  /**
+   * @brief Not RT-safe. Call it after buffer.resize().
+   */
+  void resize(const HardwareBuffer& buffer, const double deadband = 0.0)
+  {
+    const std::size_t nd = buffer.digitalNames().size();
+    const std::size_t na = buffer.analogNames().size();
+    digital_.assign(words(nd), 0);
+    digital_dirty_.assign(words(nd), 0);
+    analog_reported_.assign(na, 0.0);
+    analog_deadband_.assign(na, deadband);
+    analog_dirty_.assign(words(na), 0);
+    first_ = true;
+  }
+
+  void setAnalogDeadband(const std::size_t channel, const double deadband)
+  {
+    analog_deadband_.at(channel) = deadband;
+  }
+
+  void update(const HardwareBuffer& buffer)
+  {
+    const AlignedColumn<bool>& d = buffer.digitalValue();
+    for (std::size_t w = 0; w < digital_.size(); w++)
+    {
+      uint64_t word = 0;
+      const std::size_t begin = w * 64;
+      const std::size_t end   = std::min<std::size_t>(begin + 64, d.size());
+      for (std::size_t i = begin; i < end; i++)
+      {
+        word |= static_cast<uint64_t>(d[i]) << (i - begin);
+      }
+      digital_dirty_[w] = first_ ? mask(end - begin) : (word ^ digital_[w]);
+      digital_[w] = word;
+    }
+
+    const AlignedColumn<double>& a = buffer.analogValue();
+    std::fill(analog_dirty_.begin(), analog_dirty_.end(), 0);
+    for (std::size_t i = 0; i < analog_reported_.size(); i++)
+    {
+      if (first_ || std::fabs(a[i] - analog_reported_[i]) > analog_deadband_[i])
+      {
+        analog_reported_[i] = a[i];
+        analog_dirty_[i >> 6] |= uint64_t(1) << (i & 63);
+      }
+    }
+    first_ = false;
+  }
+
+  // ======================================================= consumer side
+  std::size_t digitalWords() const { return digital_.size(); }
+  std::size_t analogWords() const { return analog_dirty_.size(); }
+
+  /**
+   * @return the digital values of the channels [64 * w, 64 * w + 63], bit i is the channel 64 * w + i
+   */
+  uint64_t digitalWord(const std::size_t w) const { return digital_[w]; }
+  uint64_t digitalDirty(const std::size_t w) const { return digital_dirty_[w]; }
+  uint64_t analogDirty(const std::size_t w) const { return analog_dirty_[w]; }
+  bool     digital(const std::size_t channel) const { return (digital_[channel >> 6] >> (channel & 63)) & 1U; }
+
+  /**
+   * @brief the last flagged value, i.e. the value that the consumers have been notified of
+   */
+  double analogReported(const std::size_t channel) const { return analog_reported_[channel]; }
+
+  bool anyChange() const
+  {
+    for (const uint64_t& w : digital_dirty_)
+    {
+      if (w)
+      {
+        return true;
+      }
+    }
+    for (const uint64_t& w : analog_dirty_)
+    {
+      if (w)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief f(channel, value) is called for each digital channel that toggled in the last cycle
+   */
+  template<typename F>
+  void forEachDigitalChange(F&& f) const
+  {
+    for (std::size_t w = 0; w < digital_dirty_.size(); w++)
+    {
+      for (uint64_t m = digital_dirty_[w]; m; m &= m - 1)
+      {
+        const std::size_t channel = w * 64 + static_cast<std::size_t>(__builtin_ctzll(m));
+        f(channel, digital(channel));
+      }
+    }
+  }
+
+  /**
+   * @brief f(channel, value) is called for each analog channel that moved more than its deadband
+   */
+  template<typename F>
+  void forEachAnalogChange(F&& f) const
+  {
+    for (std::size_t w = 0; w < analog_dirty_.size(); w++)
+    {
+      for (uint64_t m = analog_dirty_[w]; m; m &= m - 1)
+      {
+        const std::size_t channel = w * 64 + static_cast<std::size_t>(__builtin_ctzll(m));
+        f(channel, analog_reported_[channel]);
+      }
+    }
+  }
+
+private:
+  static std::size_t words(const std::size_t n)
+  {
+    return (n + 63) / 64;
+  }
+  static uint64_t mask(const std::size_t bits)
+  {
+    return bits >= 64 ? ~uint64_t(0) : ((uint64_t(1) << bits) - 1);
+  }
+
+  bool                  first_;
+  std::vector<uint64_t> digital_;
+  std::vector<uint64_t> digital_dirty_;
+  std::vector<double>   analog_reported_;
+  std::vector<double>   analog_deadband_;
+  std::vector<uint64_t> analog_dirty_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_IO_CHANGE_H
@@ -0,0 +1,129 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_JOINT_GROUP_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_JOINT_GROUP_H
+
+#include <cstddef>
+#include <vector>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief One quantity (e.g. the command velocity) of a group of joints, accessed through the pointers stored in the
+ * handles. When the storage of the joints is contiguous (e.g. the columns of the HardwareBuffer) the copies are
+ * plain loops over an array, that the compiler vectorizes; otherwise each element is accessed through its pointer.
+ */
+template<typename T>
+class JointGroupColumn
+{
+public:
+  JointGroupColumn() : contiguous_(false) {}
+
+  explicit JointGroupColumn(const std::vector<T*>& ptrs)
+    : ptrs_(ptrs), contiguous_(!ptrs.empty())
+  {
+    for (std::size_t i = 1; i < ptrs_.size() && contiguous_; i++)
+    {
+      contiguous_ = (ptrs_[i] == ptrs_[0] + i);
+    }
+  }
+
+  std::size_t size() const
+  {
+    return ptrs_.size();
+  }
+
+  bool contiguous() const
+  {
+    return contiguous_;
+  }
+
+  /**
+   * @return the pointer to the first element if the storage is contiguous, nullptr otherwise
+   */
+  T* data() const
+  {
+    return contiguous_ ? ptrs_[0] : nullptr;
+  }
+
+  void get(double* out) const
+  {
+    const std::size_t n = ptrs_.size();
+    if (contiguous_)
+    {
+      const T* in = ptrs_[0];
+      for (std::size_t i = 0; i < n; i++)
+      {
+        out[i] = in[i];
+      }
+    }
+    else
+    {
+      for (std::size_t i = 0; i < n; i++)
+      {
+        out[i] = *ptrs_[i];
+      }
+    }
+  }
+
+  void set(const double* in) const
+  {
+    const std::size_t n = ptrs_.size();
+    if (contiguous_)
+    {
+      T* out = ptrs_[0];
+      for (std::size_t i = 0; i < n; i++)
+      {
+        out[i] = in[i];
+      }
+    }
+    else
+    {
+      for (std::size_t i = 0; i < n; i++)
+      {
+        *ptrs_[i] = in[i];
+      }
+    }
+  }
+
+private:
+  std::vector<T*> ptrs_;
+  bool            contiguous_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_JOINT_GROUP_H
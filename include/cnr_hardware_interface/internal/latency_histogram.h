@@ -0,0 +1,198 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_LATENCY_HISTOGRAM_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Fixed-bucket, log-linear (HDR-style) histogram of durations.
+ *
+ * The durations are recorded in nanoseconds. Each power of two is split in 2^kSubBits linear sub-buckets, so the
+ * relative error of a bucket is below 2^-kSubBits (about 6%), from 1 ns up to 2^kMaxExp ns (about 68 s).
+ * Longer durations are accumulated in the last bucket.
+ *
+ * record() is meant to be called by a single thread (the RT thread): it does not lock nor allocate, it only updates
+ * a few relaxed atomics. Any other thread can read the percentiles at the same time.
+ */
+class LatencyHistogram
+{
+public:
+  static constexpr unsigned    kSubBits  = 4;
+  static constexpr unsigned    kMaxExp   = 36;
+  static constexpr uint64_t    kSubCount = uint64_t(1) << kSubBits;
+  static constexpr std::size_t kBuckets  = kSubCount + (kMaxExp - kSubBits + 1) * kSubCount;
+
+  LatencyHistogram() : total_(0), max_(0), reset_(false)
+  {
+    for (std::atomic<uint64_t>& c : counts_)
+    {
+      c.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void record(const double seconds)
+  {
+    record(seconds > 0 ? static_cast<uint64_t>(seconds * 1e9) : uint64_t(0));
+  }
+
+  void record(const uint64_t ns)
+  {
+    if (reset_.load(std::memory_order_relaxed))
+    {
+      clear();
+      reset_.store(false, std::memory_order_release);
+    }
+    std::atomic<uint64_t>& c = counts_[bucket(ns)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    total_.store(total_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (ns > max_.load(std::memory_order_relaxed))
+    {
+      max_.store(ns, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief The histogram is cleared by the writer at its next record(), so that the reset is RT-safe
+   */
+  void requestReset()
+  {
+    reset_.store(true, std::memory_order_release);
+  }
+
+  uint64_t count() const
+  {
+    return total_.load(std::memory_order_relaxed);
+  }
+
+  double max() const
+  {
+    return static_cast<double>(max_.load(std::memory_order_relaxed)) * 1e-9;
+  }
+
+  /**
+   * @param quantiles, sorted quantiles in [0,1], e.g. {0.5, 0.99, 0.999}
+   * @param out, the corresponding durations in seconds (upper bound of the bucket, capped by the max recorded)
+   * @return the number of samples the percentiles are computed on
+   */
+  uint64_t percentiles(const double* quantiles, const std::size_t n, double* out) const
+  {
+    std::array<uint64_t, kBuckets> counts;
+    uint64_t total = 0;
+    for (std::size_t i = 0; i < kBuckets; i++)
+    {
+      counts[i] = counts_[i].load(std::memory_order_relaxed);
+      total += counts[i];
+    }
+    const double max_s = max();
+
+    std::size_t q = 0;
+    uint64_t cumulated = 0;
+    for (std::size_t i = 0; i < kBuckets && q < n; i++)
+    {
+      cumulated += counts[i];
+      while (q < n && total > 0 && static_cast<double>(cumulated) >= quantiles[q] * static_cast<double>(total))
+      {
+        double upper = static_cast<double>(upperBound(i)) * 1e-9;
+        out[q] = upper < max_s ? upper : max_s;
+        q++;
+      }
+    }
+    for (; q < n; q++)
+    {
+      out[q] = total > 0 ? max_s : 0.0;
+    }
+    return total;
+  }
+
+  double percentile(const double quantile) const
+  {
+    double ret = 0.0;
+    percentiles(&quantile, 1, &ret);
+    return ret;
+  }
+
+  static std::size_t bucket(const uint64_t ns)
+  {
+    if (ns < kSubCount)
+    {
+      return static_cast<std::size_t>(ns);
+    }
+    const unsigned msb = 63U - static_cast<unsigned>(__builtin_clzll(ns));
+    if (msb > kMaxExp)
+    {
+      return kBuckets - 1;
+    }
+    const uint64_t sub = (ns >> (msb - kSubBits)) & (kSubCount - 1);
+    return static_cast<std::size_t>(kSubCount + (msb - kSubBits) * kSubCount + sub);
+  }
+
+  static uint64_t upperBound(const std::size_t bucket)
+  {
+    if (bucket < kSubCount)
+    {
+      return bucket;
+    }
+    const uint64_t msb = (bucket - kSubCount) / kSubCount + kSubBits;
+    const uint64_t sub = (bucket - kSubCount) % kSubCount;
+    return ((kSubCount + sub + 1) << (msb - kSubBits)) - 1;
+  }
+
+private:
+  void clear()
+  {
+    for (std::atomic<uint64_t>& c : counts_)
+    {
+      c.store(0, std::memory_order_relaxed);
+    }
+    total_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<uint64_t>, kBuckets> counts_;
+  std::atomic<uint64_t>                       total_;
+  std::atomic<uint64_t>                       max_;
+  std::atomic<bool>                           reset_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_LATENCY_HISTOGRAM_H
@@ -0,0 +1,123 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_MAILBOX_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_MAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Lock-free single-producer/single-consumer mailbox (triple buffer).
+ *
+ * The producer (e.g. a ROS callback, in a no-RT thread) fills the back buffer and publishes it, the consumer (the
+ * RT thread) fetches the last published value. Neither of them ever blocks, and the consumer always sees a complete
+ * value: the intermediate values are overwritten if the consumer is slower than the producer.
+ * No allocation happens after the construction, as far as the copy-assignment of T does not allocate (e.g. a
+ * std::vector of the same size as the initial value).
+ */
+template<typename T>
+class Mailbox
+{
+public:
+  Mailbox() : back_(0), front_(1), middle_(2) {}
+  explicit Mailbox(const T& init) : back_(0), front_(1), middle_(2)
+  {
+    for (T& b : buffers_)
+    {
+      b = init;
+    }
+  }
+
+  Mailbox(const Mailbox&) = delete;
+  Mailbox& operator=(const Mailbox&) = delete;
+
+  // ======================================================= producer side
+  T& back()
+  {
+    return buffers_[back_];
+  }
+  void publish()
+  {
+    back_ = middle_.exchange(static_cast<uint8_t>(back_ | kFresh), std::memory_order_acq_rel) & kIndex;
+  }
+  void write(const T& value)
+  {
+    back() = value;
+    publish();
+  }
+
+  // ======================================================= consumer side
+  /**
+   * @return true if a new value has been published since the last fetch(). The value is then in front()
+   */
+  bool fetch()
+  {
+    if (!(middle_.load(std::memory_order_relaxed) & kFresh))
+    {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+    return true;
+  }
+  const T& front() const
+  {
+    return buffers_[front_];
+  }
+  bool read(T& value)
+  {
+    if (!fetch())
+    {
+      return false;
+    }
+    value = front();
+    return true;
+  }
+
+private:
+  static constexpr uint8_t kIndex = 0x3;
+  static constexpr uint8_t kFresh = 0x4;
+
+  T                    buffers_[3];
+  uint8_t              back_;
+  uint8_t              front_;
+  std::atomic<uint8_t> middle_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_MAILBOX_H
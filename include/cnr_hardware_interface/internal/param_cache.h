@@ -0,0 +1,250 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_PARAM_CACHE_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_PARAM_CACHE_H
+
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <XmlRpc/XmlRpcValue.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Local copy of the whole parameter subtree of a namespace, fetched with a single call to the master.
+ *
+ * The keys are relative to the namespace, and they can be nested ("joint_resource/joint_names"). The getters
+ * never contact the master, so doInit() can query as many keys as needed without slowing down the start-up.
+ * The cache is not refreshed: a parameter set after load() is not seen until the next load().
+ */
+class ParamCache
+{
+public:
+  ParamCache() : loaded_(false) {}
+
+  /**
+   * @return false if the namespace has no parameters
+   */
+  bool load(const ros::NodeHandle& nh)
+  {
+    ns_ = nh.getNamespace();
+    root_ = XmlRpc::XmlRpcValue();
+    loaded_ = nh.getParam(ns_, root_) && root_.getType() == XmlRpc::XmlRpcValue::TypeStruct;
+    return loaded_;
+  }
+
+  /**
+   * @brief It uses the given tree, e.g. fetched elsewhere, instead of asking the master
+   */
+  bool load(const std::string& ns, const XmlRpc::XmlRpcValue& root)
+  {
+    ns_ = ns;
+    root_ = root;
+    loaded_ = root_.getType() == XmlRpc::XmlRpcValue::TypeStruct;
+    return loaded_;
+  }
+
+  bool loaded() const
+  {
+    return loaded_;
+  }
+  const std::string& getNamespace() const
+  {
+    return ns_;
+  }
+
+  /**
+   * @return the value of the key, nullptr if not found
+   */
+  XmlRpc::XmlRpcValue* find(const std::string& key) const
+  {
+    if (!loaded_)
+    {
+      return nullptr;
+    }
+    XmlRpc::XmlRpcValue* node = &root_;
+    std::size_t begin = 0;
+    while (begin <= key.size())
+    {
+      std::size_t end = key.find('/', begin);
+      end = (end == std::string::npos) ? key.size() : end;
+      const std::string name = key.substr(begin, end - begin);
+      if (!name.empty())
+      {
+        if (node->getType() != XmlRpc::XmlRpcValue::TypeStruct || !node->hasMember(name))
+        {
+          return nullptr;
+        }
+        node = &(*node)[name];
+      }
+      begin = end + 1;
+    }
+    return node;
+  }
+
+  bool has(const std::string& key) const
+  {
+    return find(key) != nullptr;
+  }
+
+  bool get(const std::string& key, bool& value) const
+  {
+    XmlRpc::XmlRpcValue* v = find(key);
+    if (!v || v->getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+    {
+      return false;
+    }
+    value = static_cast<bool&>(*v);
+    return true;
+  }
+
+  bool get(const std::string& key, int& value) const
+  {
+    XmlRpc::XmlRpcValue* v = find(key);
+    if (!v || v->getType() != XmlRpc::XmlRpcValue::TypeInt)
+    {
+      return false;
+    }
+    value = static_cast<int&>(*v);
+    return true;
+  }
+
+  bool get(const std::string& key, double& value) const
+  {
+    XmlRpc::XmlRpcValue* v = find(key);
+    return v && toDouble(*v, value);
+  }
+
+  bool get(const std::string& key, std::string& value) const
+  {
+    XmlRpc::XmlRpcValue* v = find(key);
+    if (!v || v->getType() != XmlRpc::XmlRpcValue::TypeString)
+    {
+      return false;
+    }
+    value = static_cast<std::string&>(*v);
+    return true;
+  }
+
+  /**
+   * @brief A single string is returned as a vector of one element
+   */
+  bool get(const std::string& key, std::vector<std::string>& value) const
+  {
+    XmlRpc::XmlRpcValue* v = find(key);
+    if (!v)
+    {
+      return false;
+    }
+    if (v->getType() == XmlRpc::XmlRpcValue::TypeString)
+    {
+      value.assign(1, static_cast<std::string&>(*v));
+      return true;
+    }
+    if (v->getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+      return false;
+    }
+    std::vector<std::string> ret;
+    for (int i = 0; i < v->size(); i++)
+    {
+      if ((*v)[i].getType() != XmlRpc::XmlRpcValue::TypeString)
+      {
+        return false;
+      }
+      ret.push_back(static_cast<std::string&>((*v)[i]));
+    }
+    value = ret;
+    return true;
+  }
+
+  bool get(const std::string& key, std::vector<double>& value) const
+  {
+    XmlRpc::XmlRpcValue* v = find(key);
+    if (!v || v->getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+      return false;
+    }
+    std::vector<double> ret(static_cast<std::size_t>(v->size()));
+    for (int i = 0; i < v->size(); i++)
+    {
+      if (!toDouble((*v)[i], ret[static_cast<std::size_t>(i)]))
+      {
+        return false;
+      }
+    }
+    value = ret;
+    return true;
+  }
+
+  /**
+   * @brief As get(), but the default value is assigned if the key is not found (or it has a different type)
+   */
+  template<typename T>
+  bool get(const std::string& key, T& value, const T& default_value) const
+  {
+    if (get(key, value))
+    {
+      return true;
+    }
+    value = default_value;
+    return false;
+  }
+
+private:
+  static bool toDouble(XmlRpc::XmlRpcValue& v, double& value)
+  {
+    if (v.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    {
+      value = static_cast<double&>(v);
+      return true;
+    }
+    if (v.getType() == XmlRpc::XmlRpcValue::TypeInt)
+    {
+      value = static_cast<double>(static_cast<int&>(v));
+      return true;
+    }
+    return false;
+  }
+
+  std::string                 ns_;
+  mutable XmlRpc::XmlRpcValue root_;
+  bool                        loaded_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_PARAM_CACHE_H
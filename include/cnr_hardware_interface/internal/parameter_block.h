@@ -0,0 +1,225 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_PARAMETER_BLOCK_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_PARAMETER_BLOCK_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+#include <cnr_hardware_interface/internal/mailbox.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief The values of the tunable parameters, as a flat array indexed by declaration order
+ */
+struct ParameterValues
+{
+  uint64_t            version;
+  std::vector<double> values;
+};
+
+/**
+ * @brief Double-buffered block of tunable parameters (e.g. gains and limits of the driver).
+ *
+ * The parameters are declared before the RT loop starts, then the block is sealed. Then, any no-RT thread can
+ * stage a batch of new values: the batch is validated as a whole, and it is applied by the RT thread at the next
+ * commit(), i.e. at a cycle boundary. The RT thread therefore never sees half of a batch, and it never locks nor
+ * allocates. Since the declarations are refused once sealed, names(), size() and index() can be called by any
+ * thread from then on.
+ */
+class ParameterBlock
+{
+public:
+  ParameterBlock() : sealed_(false), mailbox_(new Mailbox<ParameterValues>())
+  {
+    active_.version = 0;
+    staged_.version = 0;
+  }
+
+  ParameterBlock(const ParameterBlock&) = delete;
+  ParameterBlock& operator=(const ParameterBlock&) = delete;
+
+  /**
+   * @brief Not RT-safe, to be called before the RT loop. Declaring again a name changes its default value.
+   * @return the index of the parameter, for value(), or size() if the block is sealed
+   */
+  std::size_t declare(const std::string& name, const double value)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sealed_)
+    {
+      return names_.size();
+    }
+    auto it = index_.find(name);
+    std::size_t idx = 0;
+    if (it == index_.end())
+    {
+      idx = names_.size();
+      names_.push_back(name);
+      index_[name] = idx;
+      staged_.values.push_back(value);
+    }
+    else
+    {
+      idx = it->second;
+      staged_.values.at(idx) = value;
+    }
+    active_ = staged_;
+    mailbox_.reset(new Mailbox<ParameterValues>(staged_));
+    return idx;
+  }
+
+  /**
+   * @brief Not RT-safe. seal() before staging any batch from other threads, unseal() only when no other thread
+   * uses the block anymore (e.g. to initialize again)
+   */
+  void seal()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sealed_ = true;
+  }
+  void unseal()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sealed_ = false;
+  }
+  bool sealed() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sealed_;
+  }
+
+  std::size_t size() const
+  {
+    return names_.size();
+  }
+  const std::vector<std::string>& names() const
+  {
+    return names_;
+  }
+  /**
+   * @return size() if the name has not been declared
+   */
+  std::size_t index(const std::string& name) const
+  {
+    auto it = index_.find(name);
+    return it == index_.end() ? names_.size() : it->second;
+  }
+
+  /**
+   * @brief Not RT-safe, any thread. The batch is applied entirely, or not at all.
+   * @return false (and 'what' is filled) if any name has not been declared
+   */
+  bool stage(const std::vector<std::pair<std::string, double>>& batch, std::string* what = nullptr)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& p : batch)
+    {
+      if (index_.find(p.first) == index_.end())
+      {
+        if (what)
+        {
+          *what = "parameter '" + p.first + "' not declared";
+        }
+        return false;
+      }
+    }
+    if (batch.empty())
+    {
+      return true;
+    }
+    for (const auto& p : batch)
+    {
+      staged_.values[index_.at(p.first)] = p.second;
+    }
+    staged_.version++;
+    mailbox_->write(staged_);
+    return true;
+  }
+
+  /**
+   * @brief Not RT-safe, any thread: the last staged values (the ones that are active, or will be at the next commit)
+   */
+  ParameterValues staged() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return staged_;
+  }
+
+  // ======================================================= RT side
+  /**
+   * @return true if a new batch has been applied
+   */
+  bool commit()
+  {
+    if (!mailbox_->fetch())
+    {
+      return false;
+    }
+    active_.version = mailbox_->front().version;
+    active_.values  = mailbox_->front().values;  // same size, no allocation
+    return true;
+  }
+  double value(const std::size_t idx) const
+  {
+    return active_.values[idx];
+  }
+  /**
+   * @return 0 before the first committed batch, and it increases at each batch
+   */
+  uint64_t version() const
+  {
+    return active_.version;
+  }
+
+private:
+  mutable std::mutex                         mutex_;
+  bool                                       sealed_;
+  std::vector<std::string>                   names_;
+  std::map<std::string, std::size_t>         index_;
+  ParameterValues                            staged_;
+  ParameterValues                            active_;
+  std::unique_ptr<Mailbox<ParameterValues>>  mailbox_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_PARAMETER_BLOCK_H
@@ -0,0 +1,161 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_PHASE_TIMING_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_PHASE_TIMING_H
+
+#include <array>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <memory>
+#include <cnr_hardware_interface/internal/running_stats.h>
+#include <cnr_hardware_interface/internal/latency_histogram.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief The phases of the RT methods of the RobotHW that are timed
+ */
+enum class RTPhase : std::size_t
+{
+  CYCLE = 0,       // between two consecutive read()
+  READ,            // the whole read()
+  READ_CALLBACKS,  // the callback queue of the RobotHW processed in the read()
+  DO_READ,         // doRead() of the derived class
+  WRITE,           // the whole write()
+  DO_WRITE,        // doWrite() of the derived class
+  SWITCH,          // the whole doSwitch()
+  DO_SWITCH,       // doDoSwitch() of the derived class
+  COUNT
+};
+
+inline const char* to_string(const RTPhase phase)
+{
+  static const char* names[static_cast<std::size_t>(RTPhase::COUNT)] =
+    { "Cycle", "Read", "Read Callbacks", "doRead", "Write", "doWrite", "Switch", "doDoSwitch" };
+  return phase < RTPhase::COUNT ? names[static_cast<std::size_t>(phase)] : "Unknown";
+}
+
+/**
+ * @return the monotonic time, in nanoseconds
+ */
+inline uint64_t monotonicNs()
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * @brief RT-safe store of the durations of each RTPhase.
+ *
+ * Each phase has a sliding window (mean, max, min, jitter) and a latency histogram (percentiles).
+ * record() is called by the RT thread only: it does not lock nor allocate. The statistics can be read by any
+ * thread, concurrently.
+ */
+class PhaseTimingStats
+{
+public:
+  static constexpr std::size_t kPhases = static_cast<std::size_t>(RTPhase::COUNT);
+
+  explicit PhaseTimingStats(const std::size_t window_dim)
+  {
+    for (std::size_t i = 0; i < kPhases; i++)
+    {
+      windows_[i].reset(new PublishedWindowStats(window_dim));
+    }
+  }
+
+  void record(const RTPhase phase, const uint64_t ns)
+  {
+    const std::size_t i = static_cast<std::size_t>(phase);
+    windows_[i]->push(static_cast<double>(ns) * 1e-9);
+    histograms_[i].record(ns);
+  }
+
+  /**
+   * @return the statistics in seconds
+   */
+  WindowStatistics statistics(const RTPhase phase) const
+  {
+    return windows_[static_cast<std::size_t>(phase)]->statistics();
+  }
+
+  const LatencyHistogram& histogram(const RTPhase phase) const
+  {
+    return histograms_[static_cast<std::size_t>(phase)];
+  }
+
+  std::size_t windowDim() const
+  {
+    return windows_[0]->dim();
+  }
+
+private:
+  std::array<std::unique_ptr<PublishedWindowStats>, kPhases> windows_;
+  std::array<LatencyHistogram, kPhases>                      histograms_;
+};
+
+/**
+ * @brief Records the duration of the enclosing scope in the PhaseTimingStats (it covers the early returns)
+ */
+class ScopedPhaseRecord
+{
+public:
+  ScopedPhaseRecord(PhaseTimingStats& stats, const RTPhase phase)
+    : stats_(stats), phase_(phase), start_(monotonicNs())
+  {
+  }
+  ~ScopedPhaseRecord()
+  {
+    stats_.record(phase_, monotonicNs() - start_);
+  }
+
+  uint64_t start() const
+  {
+    return start_;
+  }
+
+  ScopedPhaseRecord(const ScopedPhaseRecord&) = delete;
+  ScopedPhaseRecord& operator=(const ScopedPhaseRecord&) = delete;
+
+private:
+  PhaseTimingStats& stats_;
+  const RTPhase     phase_;
+  const uint64_t    start_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_PHASE_TIMING_H
@@ -0,0 +1,175 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_RESOURCE_INDEX_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_RESOURCE_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Fixed size bitset over the resources of the RobotHW. It is sized once (resize()), then all the
+ * operations are allocation-free.
+ */
+class ResourceBitset
+{
+public:
+  ResourceBitset() : size_(0) {}
+  explicit ResourceBitset(const std::size_t n)
+  {
+    resize(n);
+  }
+
+  void resize(const std::size_t n)
+  {
+    size_ = n;
+    words_.assign((n + 63) / 64, 0);
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+  void set(const std::size_t i)
+  {
+    words_[i >> 6] |= (uint64_t(1) << (i & 63));
+  }
+
+  void reset(const std::size_t i)
+  {
+    words_[i >> 6] &= ~(uint64_t(1) << (i & 63));
+  }
+
+  bool test(const std::size_t i) const
+  {
+    return (words_[i >> 6] >> (i & 63)) & 1U;
+  }
+
+  void clear()
+  {
+    std::fill(words_.begin(), words_.end(), 0);
+  }
+
+  bool any() const
+  {
+    for (const uint64_t& w : words_)
+    {
+      if (w)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool intersects(const ResourceBitset& rhs) const
+  {
+    const std::size_t n = std::min(words_.size(), rhs.words_.size());
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (words_[i] & rhs.words_[i])
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  ResourceBitset& operator|=(const ResourceBitset& rhs)
+  {
+    const std::size_t n = std::min(words_.size(), rhs.words_.size());
+    for (std::size_t i = 0; i < n; i++)
+    {
+      words_[i] |= rhs.words_[i];
+    }
+    return *this;
+  }
+
+  const std::vector<uint64_t>& words() const
+  {
+    return words_;
+  }
+
+private:
+  std::size_t           size_;
+  std::vector<uint64_t> words_;
+};
+
+/**
+ * @brief Map between the name of a resource and its index in the resource names of the RobotHW.
+ * It is built once (assign()), while find() does not allocate.
+ */
+class ResourceIndex
+{
+public:
+  void assign(const std::vector<std::string>& names)
+  {
+    index_.clear();
+    index_.reserve(names.size());
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+      index_.emplace(names[i], i);  // the first occurrence wins, as in a linear scan
+    }
+    size_ = names.size();
+  }
+
+  /**
+   * @return the index of the resource, -1 if the resource is not a resource of the RobotHW
+   */
+  int find(const std::string& name) const
+  {
+    std::unordered_map<std::string, std::size_t>::const_iterator it = index_.find(name);
+    return it == index_.end() ? -1 : static_cast<int>(it->second);
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+private:
+  std::unordered_map<std::string, std::size_t> index_;
+  std::size_t                                  size_ = 0;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_RESOURCE_INDEX_H
@@ -0,0 +1,135 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_RT_ALLOC_GUARD_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_RT_ALLOC_GUARD_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Counters of the heap allocations, lock acquisitions and page faults that happened inside the RT methods.
+ * Written by the RT thread (RTAllocGuard), read by the diagnostics.
+ */
+class RTAllocStats
+{
+public:
+  RTAllocStats()
+    : sections_(0), allocations_(0), worst_allocations_(0), locks_(0), minor_faults_(0), major_faults_(0),
+      abort_on_allocation_(false)
+  {
+  }
+
+  RTAllocStats(const RTAllocStats&) = delete;
+  RTAllocStats& operator=(const RTAllocStats&) = delete;
+
+  uint64_t sections() const { return sections_.load(std::memory_order_relaxed); }
+  uint64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+  uint64_t worstAllocations() const { return worst_allocations_.load(std::memory_order_relaxed); }
+  uint64_t locks() const { return locks_.load(std::memory_order_relaxed); }
+  uint64_t minorFaults() const { return minor_faults_.load(std::memory_order_relaxed); }
+  uint64_t majorFaults() const { return major_faults_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Debug setting: an allocation inside a guarded section calls std::abort(), so that the stack trace
+   * (e.g. in gdb, or in the core dump) shows who allocates
+   */
+  void setAbortOnAllocation(const bool abort) { abort_on_allocation_.store(abort, std::memory_order_relaxed); }
+  bool abortOnAllocation() const { return abort_on_allocation_.load(std::memory_order_relaxed); }
+
+  void add(const uint64_t allocations, const uint64_t locks, const uint64_t minor_faults, const uint64_t major_faults)
+  {
+    sections_.store(sections() + 1, std::memory_order_relaxed);
+    allocations_.store(this->allocations() + allocations, std::memory_order_relaxed);
+    if (allocations > worstAllocations())
+    {
+      worst_allocations_.store(allocations, std::memory_order_relaxed);
+    }
+    locks_.store(this->locks() + locks, std::memory_order_relaxed);
+    minor_faults_.store(minorFaults() + minor_faults, std::memory_order_relaxed);
+    major_faults_.store(majorFaults() + major_faults, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint64_t> sections_;
+  std::atomic<uint64_t> allocations_;
+  std::atomic<uint64_t> worst_allocations_;
+  std::atomic<uint64_t> locks_;
+  std::atomic<uint64_t> minor_faults_;
+  std::atomic<uint64_t> major_faults_;
+  std::atomic<bool>     abort_on_allocation_;
+};
+
+/**
+ * @return true if the library has been built with -DCNR_HW_RT_ALLOC_CHECK=ON, i.e. the allocation and lock hooks
+ * are installed and the guards count
+ */
+bool rtAllocTrackingEnabled();
+
+/**
+ * @brief RAII guard of a RT section: it counts the operator new calls and the pthread_mutex_lock calls of the
+ * current thread (through the hooks of rt_alloc_hooks.cpp), and the page faults (getrusage(RUSAGE_THREAD)).
+ * Nested guards are allowed, only the outermost one accumulates in the stats.
+ * Use the CNR_HW_RT_ALLOC_GUARD macro, that compiles out when the tracking is disabled.
+ */
+class RTAllocGuard
+{
+public:
+  explicit RTAllocGuard(RTAllocStats& stats);
+  ~RTAllocGuard();
+
+  RTAllocGuard(const RTAllocGuard&) = delete;
+  RTAllocGuard& operator=(const RTAllocGuard&) = delete;
+
+private:
+  RTAllocStats& stats_;
+  bool          outermost_;
+  uint64_t      allocations_;
+  uint64_t      locks_;
+  uint64_t      minor_faults_;
+  uint64_t      major_faults_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#if defined(CNR_HARDWARE_INTERFACE_RT_ALLOC_CHECK)
+#define CNR_HW_RT_ALLOC_GUARD(stats) cnr_hardware_interface::RTAllocGuard cnr_hw_rt_alloc_guard(stats)
+#else
+#define CNR_HW_RT_ALLOC_GUARD(stats) do {} while (false)
+#endif
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_RT_ALLOC_GUARD_H
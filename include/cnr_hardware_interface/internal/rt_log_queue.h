@@ -0,0 +1,140 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_RT_LOG_QUEUE_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_RT_LOG_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <cnr_hardware_interface/internal/phase_timing.h>
+
+namespace cnr_hardware_interface
+{
+
+enum class RTLogLevel : uint8_t
+{
+  DEBUG = 0,
+  INFO,
+  WARN,
+  ERROR,
+  FATAL
+};
+
+/**
+ * @brief Fixed size log record. The message is truncated to kMsgSize - 1 chars.
+ */
+struct RTLogRecord
+{
+  static constexpr std::size_t kMsgSize = 112;
+
+  uint64_t   stamp_ns;
+  RTLogLevel level;
+  char       msg[kMsgSize];
+};
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring of RTLogRecord.
+ *
+ * The producer (the RT thread) only copies the message in a preallocated slot: it never locks, allocates or does
+ * any I/O. When the ring is full the record is dropped and counted. The consumer (a background thread) pops the
+ * records and forwards them to the logger.
+ */
+class RTLogQueue
+{
+public:
+  explicit RTLogQueue(const std::size_t capacity)
+    : capacity_(capacity < 2 ? 2 : capacity), records_(new RTLogRecord[capacity_]), head_(0), tail_(0), dropped_(0)
+  {
+  }
+
+  RTLogQueue(const RTLogQueue&) = delete;
+  RTLogQueue& operator=(const RTLogQueue&) = delete;
+
+  bool push(const RTLogLevel level, const char* msg)
+  {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= capacity_)
+    {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    RTLogRecord& r = records_[head % capacity_];
+    r.stamp_ns = monotonicNs();
+    r.level    = level;
+    std::strncpy(r.msg, msg ? msg : "", RTLogRecord::kMsgSize - 1);
+    r.msg[RTLogRecord::kMsgSize - 1] = '\0';
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(RTLogRecord& record)
+  {
+    const uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    record = records_[tail % capacity_];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::size_t size() const
+  {
+    return static_cast<std::size_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+  }
+
+  std::size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  uint64_t dropped() const
+  {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  const std::size_t               capacity_;
+  std::unique_ptr<RTLogRecord[]>  records_;
+  std::atomic<uint64_t>           head_;
+  std::atomic<uint64_t>           tail_;
+  std::atomic<uint64_t>           dropped_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_RT_LOG_QUEUE_H
@@ -0,0 +1,87 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_RT_TRACE_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_RT_TRACE_H
+
+#include <cnr_logger/cnr_logger.h>
+
+#if defined(__GNUC__)
+#define CNR_HW_LIKELY(x)   __builtin_expect(!!(x), 1)
+#define CNR_HW_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define CNR_HW_LIKELY(x)   (x)
+#define CNR_HW_UNLIKELY(x) (x)
+#endif
+
+/**
+ * Tracing of the methods called at each cycle (read, write).
+ *
+ * If CNR_HARDWARE_INTERFACE_DISABLE_RT_TRACE is defined (cmake option CNR_HW_RT_TRACE=OFF), the trace is compiled
+ * out. Otherwise, the trace is skipped, with a single predictable branch, when 'rt_mode' is true: no strings are
+ * built and no clock is read in the RT thread.
+ * The error messages are not affected.
+ */
+#if defined(CNR_HARDWARE_INTERFACE_DISABLE_RT_TRACE)
+
+#define CNR_HW_RT_TRACE_START(logger, rt_mode) \
+  do { (void)(rt_mode); } while (false)
+
+#define CNR_HW_RT_RETURN_OK(logger, rt_mode, ret) \
+  return ret
+
+#else
+
+#define CNR_HW_RT_TRACE_START(logger, rt_mode) \
+  do \
+  { \
+    if (CNR_HW_UNLIKELY(!(rt_mode))) \
+    { \
+      CNR_TRACE_START_THROTTLE_DEFAULT(logger); \
+    } \
+  } while (false)
+
+#define CNR_HW_RT_RETURN_OK(logger, rt_mode, ret) \
+  do \
+  { \
+    if (CNR_HW_LIKELY(rt_mode)) \
+    { \
+      return ret; \
+    } \
+    CNR_RETURN_OK_THROTTLE_DEFAULT(logger, ret); \
+  } while (false)
+
+#endif
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_RT_TRACE_H
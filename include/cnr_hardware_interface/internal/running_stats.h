@@ -0,0 +1,234 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_RUNNING_STATS_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_RUNNING_STATS_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <cnr_hardware_interface/internal/seqlock.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief All the statistics of a window, returned together by a single snapshot.
+ * The jitter is the standard deviation of the samples in the window.
+ */
+struct WindowStatistics
+{
+  uint32_t samples;
+  double   last;
+  double   mean;
+  double   max;
+  double   min;
+  double   variance;
+  double   jitter;
+};
+
+/**
+ * @brief Sliding window statistics computed incrementally.
+ *
+ * The running sum and sum of squares give the mean and the variance, while two monotonic deques give the max
+ * and the min of the window. Each push() is O(1) amortized, and statistics() is O(1).
+ * All the storage is allocated in the constructor: push() never allocates. It is not thread-safe, and it is
+ * meant to be owned by the producer thread.
+ */
+class SlidingWindowStats
+{
+public:
+  explicit SlidingWindowStats(const std::size_t dim)
+    : dim_(std::max<std::size_t>(dim, 1)), values_(dim_, 0.0), count_(0), sum_(0.0), sum_sq_(0.0)
+    , max_(dim_), min_(dim_)
+  {
+  }
+
+  void push(const double v)
+  {
+    const std::size_t slot = count_ % dim_;
+    if (count_ >= dim_)
+    {
+      const double old = values_[slot];
+      sum_    -= old;
+      sum_sq_ -= old * old;
+    }
+    values_[slot] = v;
+    sum_    += v;
+    sum_sq_ += v * v;
+
+    const uint64_t oldest = count_ >= dim_ ? count_ - dim_ + 1 : 0;
+    max_.push(count_, v, oldest, [](double a, double b) { return a <= b; });  // NOLINT(whitespace/braces)
+    min_.push(count_, v, oldest, [](double a, double b) { return a >= b; });  // NOLINT(whitespace/braces)
+    count_++;
+  }
+
+  void reset()
+  {
+    count_  = 0;
+    sum_    = 0.0;
+    sum_sq_ = 0.0;
+    max_.clear();
+    min_.clear();
+  }
+
+  std::size_t size() const
+  {
+    return static_cast<std::size_t>(std::min<uint64_t>(count_, dim_));
+  }
+
+  std::size_t dim() const
+  {
+    return dim_;
+  }
+
+  WindowStatistics statistics() const
+  {
+    WindowStatistics ret = {0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    const std::size_t n = size();
+    if (n == 0)
+    {
+      return ret;
+    }
+    ret.samples  = static_cast<uint32_t>(n);
+    ret.last     = values_[(count_ - 1) % dim_];
+    ret.mean     = sum_ / static_cast<double>(n);
+    ret.max      = max_.front();
+    ret.min      = min_.front();
+    ret.variance = std::max(0.0, sum_sq_ / static_cast<double>(n) - ret.mean * ret.mean);
+    ret.jitter   = std::sqrt(ret.variance);
+    return ret;
+  }
+
+private:
+  /**
+   * @brief Fixed capacity deque of (sample index, value), monotonic with respect to the comparison
+   * used in push(). The front is the extreme of the window.
+   */
+  class MonotonicDeque
+  {
+  public:
+    explicit MonotonicDeque(const std::size_t capacity)
+      : index_(capacity, 0), value_(capacity, 0.0), begin_(0), size_(0)
+    {
+    }
+
+    template<typename Dominated>
+    void push(const uint64_t index, const double v, const uint64_t oldest, Dominated dominated)
+    {
+      while (size_ > 0 && index_[begin_] < oldest)
+      {
+        begin_ = next(begin_);
+        size_--;
+      }
+      while (size_ > 0 && dominated(value_[back()], v))
+      {
+        size_--;
+      }
+      const std::size_t slot = (begin_ + size_) % index_.size();
+      index_[slot] = index;
+      value_[slot] = v;
+      size_++;
+    }
+
+    double front() const
+    {
+      return value_[begin_];
+    }
+
+    void clear()
+    {
+      begin_ = 0;
+      size_  = 0;
+    }
+
+  private:
+    std::size_t next(const std::size_t i) const
+    {
+      return (i + 1) % index_.size();
+    }
+    std::size_t back() const
+    {
+      return (begin_ + size_ - 1) % index_.size();
+    }
+
+    std::vector<uint64_t> index_;
+    std::vector<double>   value_;
+    std::size_t           begin_;
+    std::size_t           size_;
+  };
+
+  const std::size_t   dim_;
+  std::vector<double> values_;
+  uint64_t            count_;
+  double              sum_;
+  double              sum_sq_;
+  MonotonicDeque      max_;
+  MonotonicDeque      min_;
+};
+
+/**
+ * @brief SlidingWindowStats owned by a single producer, that publishes the statistics at each push() through a
+ * SeqLock. Any other thread reads the last published statistics in O(1), without locking the producer.
+ */
+class PublishedWindowStats
+{
+public:
+  explicit PublishedWindowStats(const std::size_t dim) : stats_(dim) {}
+
+  void push(const double v)
+  {
+    stats_.push(v);
+    published_.store(stats_.statistics());
+  }
+
+  WindowStatistics statistics() const
+  {
+    return published_.load();
+  }
+
+  std::size_t dim() const
+  {
+    return stats_.dim();
+  }
+
+private:
+  SlidingWindowStats              stats_;
+  SeqLockValue<WindowStatistics>  published_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_RUNNING_STATS_H
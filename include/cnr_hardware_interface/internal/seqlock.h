@@ -0,0 +1,154 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_SEQLOCK_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <thread>  // NOLINT
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Single-writer sequence lock.
+ *
+ * The writer (usually the RT thread) never blocks nor allocates: it only bumps the sequence counter before and
+ * after the update. The readers copy the protected data and retry if a write happened in the meanwhile.
+ * The protected data must be accessed through relaxed atomics, so that concurrent accesses are well defined.
+ */
+class SeqLock
+{
+public:
+  SeqLock() : seq_(0) {}
+  SeqLock(const SeqLock&) = delete;
+  SeqLock& operator=(const SeqLock&) = delete;
+
+  void writeBegin()
+  {
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void writeEnd()
+  {
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  uint64_t readBegin() const
+  {
+    uint64_t s = seq_.load(std::memory_order_acquire);
+    while (s & 1U)
+    {
+      std::this_thread::yield();
+      s = seq_.load(std::memory_order_acquire);
+    }
+    return s;
+  }
+
+  /**
+   * @return true if the data copied after readBegin() may be inconsistent, and the read has to be repeated
+   */
+  bool readRetry(uint64_t s) const
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq_.load(std::memory_order_relaxed) != s;
+  }
+
+private:
+  std::atomic<uint64_t> seq_;
+};
+
+/**
+ * @brief A trivially copyable value published by a single writer through a SeqLock.
+ * The value is stored as an array of relaxed atomic words, therefore the torn reads are detected and repeated.
+ */
+template<typename T>
+class SeqLockValue
+{
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLockValue requires a trivially copyable type");
+
+public:
+  SeqLockValue()
+  {
+    store(T());
+  }
+  explicit SeqLockValue(const T& v)
+  {
+    store(v);
+  }
+
+  void store(const T& v)
+  {
+    uint64_t words[kWords] = {0};
+    std::memcpy(words, &v, sizeof(T));
+    lock_.writeBegin();
+    for (std::size_t i = 0; i < kWords; i++)
+    {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    lock_.writeEnd();
+  }
+
+  T load() const
+  {
+    uint64_t words[kWords];
+    uint64_t s = 0;
+    do
+    {
+      s = lock_.readBegin();
+      for (std::size_t i = 0; i < kWords; i++)
+      {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+    }
+    while (lock_.readRetry(s));
+
+    T ret;
+    std::memcpy(&ret, words, sizeof(T));
+    return ret;
+  }
+
+private:
+  static constexpr std::size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+  SeqLock               lock_;
+  std::atomic<uint64_t> words_[kWords];
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_SEQLOCK_H
@@ -0,0 +1,178 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_STATE_TRANSITIONS_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_STATE_TRANSITIONS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <cnr_hardware_interface/cnr_robot_hw_status.h>
+#include <cnr_hardware_interface/internal/phase_timing.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief The transitions of the RobotHW state machine. The self-transitions are always valid, and the error and
+ * shutdown states can be reached from any state.
+ */
+inline bool isValidTransition(const StatusHw& from, const StatusHw& to)
+{
+  if (from == to || to == ERROR || to == CTRL_ERROR || to == SRV_ERROR || to == SHUTDOWN)
+  {
+    return true;
+  }
+  switch (from)
+  {
+    case UNLOADED:        return to == CREATED;
+    case CREATED:         return to == INITIALIZING || to == INITIALIZED;
+    case INITIALIZING:    return to == INITIALIZED;
+    case INITIALIZED:     return to == RUNNING || to == READY_TO_SWITCH || to == INITIALIZING;
+    case READY_TO_SWITCH: return to == DOING_SWITCH;
+    case DOING_SWITCH:    return to == SWITCH_DONE;
+    case SWITCH_DONE:     return to == RUNNING || to == READY_TO_SWITCH;
+    case RUNNING:         return to == READY_TO_SWITCH;
+    case CTRL_ERROR:
+    case SRV_ERROR:       return to == RUNNING || to == READY_TO_SWITCH || to == INITIALIZING || to == INITIALIZED;
+    case ERROR:
+    case SHUTDOWN:        return to == CREATED || to == INITIALIZING || to == INITIALIZED;
+    default:              return false;
+  }
+}
+
+struct StateTransition
+{
+  uint64_t stamp_ns;
+  StatusHw from;
+  StatusHw to;
+  bool     accepted;  // false if the transition has been refused, since not valid
+};
+
+/**
+ * @brief Bounded lock-free multiple-producer/single-consumer ring of StateTransition.
+ *
+ * The state is changed both by the RT thread and by the controller-manager thread, so each slot has its own
+ * sequence number, and the producers reserve the slots with a CAS on the head. The records are preallocated, and
+ * when the ring is full the transition is dropped and counted. The consumer is the background thread.
+ */
+class StateTransitionRing
+{
+public:
+  explicit StateTransitionRing(const std::size_t capacity)
+    : capacity_(capacity < 2 ? 2 : capacity), slots_(new Slot[capacity_]), head_(0), tail_(0), dropped_(0)
+  {
+    for (std::size_t i = 0; i < capacity_; i++)
+    {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  StateTransitionRing(const StateTransitionRing&) = delete;
+  StateTransitionRing& operator=(const StateTransitionRing&) = delete;
+
+  bool push(const StatusHw& from, const StatusHw& to, const bool accepted)
+  {
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;)
+    {
+      slot = &slots_[pos % capacity_];
+      const int64_t diff = static_cast<int64_t>(slot->seq.load(std::memory_order_acquire) - pos);
+      if (diff == 0)
+      {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      else
+      {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->data.stamp_ns = monotonicNs();
+    slot->data.from     = from;
+    slot->data.to       = to;
+    slot->data.accepted = accepted;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(StateTransition& transition)
+  {
+    const uint64_t pos = tail_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[pos % capacity_];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1)
+    {
+      return false;
+    }
+    transition = slot.data;
+    slot.seq.store(pos + capacity_, std::memory_order_release);
+    tail_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  std::size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  uint64_t dropped() const
+  {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> seq;
+    StateTransition       data;
+  };
+
+  const std::size_t        capacity_;
+  std::unique_ptr<Slot[]>  slots_;
+  std::atomic<uint64_t>    head_;
+  std::atomic<uint64_t>    tail_;
+  std::atomic<uint64_t>    dropped_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_STATE_TRANSITIONS_H
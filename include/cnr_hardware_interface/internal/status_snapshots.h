@@ -0,0 +1,153 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_STATUS_SNAPSHOTS_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_STATUS_SNAPSHOTS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cnr_hardware_interface/internal/phase_timing.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief The snapshots of the configuration stored by RobotHW::m_set_status_param
+ */
+enum class StatusSnapshot : uint32_t
+{
+  FIRST_CONFIGURATION = 0,
+  LAST_VALID_CONFIGURATION,
+  SHUTDOWN_CONFIGURATION,
+  COUNT
+};
+
+inline const char* to_string(const StatusSnapshot& snapshot)
+{
+  switch (snapshot)
+  {
+    case StatusSnapshot::FIRST_CONFIGURATION:      return "first_configuration";
+    case StatusSnapshot::LAST_VALID_CONFIGURATION: return "last_valid_configuration";
+    case StatusSnapshot::SHUTDOWN_CONFIGURATION:   return "shutdown_configuration";
+    default:                                       return "unknown_configuration";
+  }
+}
+
+/**
+ * @brief Pending snapshot requests, coalesced in a bitmask.
+ *
+ * The RT thread only sets a bit (lock-free, no allocation). The persistence worker takes all the pending requests
+ * at once, so a rapid sequence of transitions costs a single write of the parameters. The bitmask and the stamp of
+ * the oldest pending request share a single atomic word (the stamp has a resolution of 256 ns), so that the worker
+ * never takes a bit without its stamp.
+ */
+class StatusSnapshotRequests
+{
+public:
+  StatusSnapshotRequests() : pending_(0), depth_(0), requested_(0), persisted_(0) {}
+
+  StatusSnapshotRequests(const StatusSnapshotRequests&) = delete;
+  StatusSnapshotRequests& operator=(const StatusSnapshotRequests&) = delete;
+
+  void request(const StatusSnapshot& snapshot)
+  {
+    const uint64_t stamp = std::max<uint64_t>(monotonicNs() & STAMP_MASK, BITS_MASK + 1);  // never 0
+    const uint64_t bit   = 1ULL << static_cast<uint32_t>(snapshot);
+    depth_.fetch_add(1, std::memory_order_relaxed);
+    requested_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t word = pending_.load(std::memory_order_relaxed);
+    uint64_t next = 0;
+    do
+    {
+      next = word | bit | (((word & STAMP_MASK) == 0) ? stamp : 0);
+    }
+    while (!pending_.compare_exchange_weak(word, next, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  /**
+   * @brief Consumer side
+   * @param[out] first_stamp_ns the time of the oldest request among the taken ones, 0 if none
+   * @return the bitmask of the pending snapshots, 0 if none
+   */
+  uint32_t take(uint64_t& first_stamp_ns)
+  {
+    const uint64_t word    = pending_.exchange(0, std::memory_order_acq_rel);
+    const uint32_t pending = static_cast<uint32_t>(word & BITS_MASK);
+    first_stamp_ns = word & STAMP_MASK;
+    depth_.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < static_cast<uint32_t>(StatusSnapshot::COUNT); i++)
+    {
+      persisted_ += (pending >> i) & 1U;
+    }
+    return pending;
+  }
+
+  static bool has(const uint32_t pending, const StatusSnapshot& snapshot)
+  {
+    return (pending >> static_cast<uint32_t>(snapshot)) & 1U;
+  }
+
+  /**
+   * @return the number of requests not yet taken by the worker
+   */
+  uint64_t depth() const
+  {
+    return depth_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @return the number of requests merged with another one
+   */
+  uint64_t coalesced() const
+  {
+    const uint64_t requested = requested_.load(std::memory_order_relaxed);
+    const uint64_t persisted = persisted_.load(std::memory_order_relaxed);
+    return requested > persisted + depth() ? requested - persisted - depth() : 0;
+  }
+
+private:
+  static constexpr uint64_t BITS_MASK  = 0xFFULL;
+  static constexpr uint64_t STAMP_MASK = ~BITS_MASK;
+  static_assert(static_cast<uint32_t>(StatusSnapshot::COUNT) <= 8, "the snapshot bits do not fit");
+
+  std::atomic<uint64_t> pending_;  // stamp of the oldest request | bitmask
+  std::atomic<uint64_t> depth_;
+  std::atomic<uint64_t> requested_;
+  std::atomic<uint64_t> persisted_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_STATUS_SNAPSHOTS_H
@@ -0,0 +1,195 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_SUB_DEVICES_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_SUB_DEVICES_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cnr_hardware_interface/internal/phase_timing.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Statistics of a sub-device, written by the RT thread and readable by any thread
+ */
+struct SubDeviceStats
+{
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> overruns{0};   // calls longer than the budget
+  std::atomic<uint64_t> failures{0};
+  std::atomic<uint64_t> last_ns{0};
+  std::atomic<uint64_t> max_ns{0};
+  std::atomic<uint64_t> total_ns{0};
+
+  void add(const uint64_t ns, const bool overrun, const bool failed)
+  {
+    auto inc = [](std::atomic<uint64_t>& v, const uint64_t d)
+    {
+      v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+    };
+    inc(calls, 1);
+    inc(overruns, overrun ? 1 : 0);
+    inc(failures, failed ? 1 : 0);
+    inc(total_ns, ns);
+    last_ns.store(ns, std::memory_order_relaxed);
+    if (ns > max_ns.load(std::memory_order_relaxed))
+    {
+      max_ns.store(ns, std::memory_order_relaxed);
+    }
+  }
+};
+
+/**
+ * @brief Multi-rate scheduling of the sub-devices of a RobotHW (e.g. an I/O module at 1/40 of the joint bus rate).
+ *
+ * A sub-device is due in the cycles where cycle % divisor == phase: different phases spread the devices with the
+ * same rate over different cycles. The callbacks are registered before the RT loop starts; dispatch() is RT-safe
+ * (no allocation, as far as the callbacks do not allocate) and it times each call against the budget of the device.
+ */
+class SubDeviceScheduler
+{
+public:
+  typedef std::function<bool()> Callback;
+
+  enum class Stage
+  {
+    READ = 0,
+    WRITE,
+    COUNT
+  };
+
+  struct SubDevice
+  {
+    std::string    name;
+    Callback       callbacks[static_cast<std::size_t>(Stage::COUNT)];
+    uint32_t       divisor;
+    uint32_t       phase;
+    uint64_t       budget_ns;
+    SubDeviceStats stats[static_cast<std::size_t>(Stage::COUNT)];
+  };
+
+  /**
+   * @brief Not RT-safe. Empty callbacks are skipped.
+   * @return false if divisor is 0, or phase is not less than divisor, or the name is already used
+   */
+  bool add(const std::string& name, const Callback& read, const Callback& write, const uint32_t divisor,
+           const uint32_t phase, const uint64_t budget_ns)
+  {
+    if (divisor == 0 || phase >= divisor || find(name))
+    {
+      return false;
+    }
+    std::unique_ptr<SubDevice> d(new SubDevice());
+    d->name      = name;
+    d->callbacks[static_cast<std::size_t>(Stage::READ)]  = read;
+    d->callbacks[static_cast<std::size_t>(Stage::WRITE)] = write;
+    d->divisor   = divisor;
+    d->phase     = phase;
+    d->budget_ns = budget_ns;
+    devices_.push_back(std::move(d));
+    return true;
+  }
+
+  /**
+   * @brief Not RT-safe. It removes all the sub-devices, e.g. before a new RobotHW::init()
+   */
+  void clear()
+  {
+    devices_.clear();
+  }
+
+  std::size_t size() const
+  {
+    return devices_.size();
+  }
+  const SubDevice& device(const std::size_t i) const
+  {
+    return *devices_.at(i);
+  }
+  const SubDevice* find(const std::string& name) const
+  {
+    for (const std::unique_ptr<SubDevice>& d : devices_)
+    {
+      if (d->name == name)
+      {
+        return d.get();
+      }
+    }
+    return nullptr;
+  }
+
+  static bool due(const SubDevice& d, const uint64_t cycle)
+  {
+    return (cycle % d.divisor) == d.phase;
+  }
+
+  /**
+   * @brief Call the callbacks of the stage of the devices that are due in the cycle.
+   * @return the first device that failed, nullptr if none
+   */
+  const SubDevice* dispatch(const Stage stage, const uint64_t cycle)
+  {
+    const std::size_t s = static_cast<std::size_t>(stage);
+    const SubDevice* failed = nullptr;
+    for (const std::unique_ptr<SubDevice>& d : devices_)
+    {
+      if (!d->callbacks[s] || !due(*d, cycle))
+      {
+        continue;
+      }
+      const uint64_t t0 = monotonicNs();
+      const bool ok = d->callbacks[s]();
+      const uint64_t ns = monotonicNs() - t0;
+      d->stats[s].add(ns, d->budget_ns > 0 && ns > d->budget_ns, !ok);
+      if (!ok && !failed)
+      {
+        failed = d.get();
+      }
+    }
+    return failed;
+  }
+
+private:
+  std::vector<std::unique_ptr<SubDevice>> devices_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_SUB_DEVICES_H
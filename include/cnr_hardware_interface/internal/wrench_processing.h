@@ -0,0 +1,228 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_INTERNAL_WRENCH_PROCESSING_H
+#define CNR_HARDWARE_INTERFACE_INTERNAL_WRENCH_PROCESSING_H
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <string>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Configuration of the processing of a force-torque sensor, see WrenchProcessor
+ */
+struct WrenchProcessingConfig
+{
+  double                cutoff_frequency = 0.0;  // [Hz] of the 2nd order Butterworth low-pass, 0 disables it
+  double                force_limit      = 0.0;  // [N] saturation of the raw force (any axis), 0 disables the check
+  double                torque_limit     = 0.0;  // [Nm] saturation of the raw torque (any axis), 0 disables the check
+  std::string           frame_id;                // output frame, empty to keep the one of the sensor
+  std::array<double, 3> translation  {{0.0, 0.0, 0.0}};  // origin of the sensor frame in the output frame [m]
+  std::array<double, 3> rotation_rpy {{0.0, 0.0, 0.0}};  // orientation of the sensor frame in the output frame [rad]
+};
+
+/**
+ * @brief In-loop processing of a force-torque sensor: saturation check of the raw wrench, low-pass filter, bias
+ * removal (tare) and static transform in the output frame.
+ *
+ * The coefficients and the 6x6 wrench transform are computed once by configure(); update() is RT-safe, it runs a
+ * fixed number of operations on fixed-size arrays. tare() can be called by any thread: the bias is taken by the
+ * next update(), as the filtered wrench in the sensor frame.
+ */
+class WrenchProcessor
+{
+public:
+  WrenchProcessor() : sampling_period_(1e-3), first_(true), tare_request_(false)
+  {
+    configure(WrenchProcessingConfig(), sampling_period_);
+  }
+
+  /**
+   * @brief Not RT-safe
+   */
+  void configure(const WrenchProcessingConfig& config, const double sampling_period)
+  {
+    config_          = config;
+    sampling_period_ = sampling_period;
+
+    // bilinear transform of the Butterworth low-pass
+    const double fc = config.cutoff_frequency;
+    if (fc > 0.0 && fc < 0.5 / sampling_period)
+    {
+      const double k    = std::tan(M_PI * fc * sampling_period);
+      const double norm = 1.0 / (1.0 + M_SQRT2 * k + k * k);
+      b_[0] = k * k * norm;
+      b_[1] = 2.0 * b_[0];
+      b_[2] = b_[0];
+      a_[0] = 2.0 * (k * k - 1.0) * norm;
+      a_[1] = (1.0 - M_SQRT2 * k + k * k) * norm;
+    }
+    else
+    {
+      b_ = {{1.0, 0.0, 0.0}};
+      a_ = {{0.0, 0.0}};
+    }
+
+    // R = Rz(yaw) * Ry(pitch) * Rx(roll), and the wrench transform [R 0; [p]x R R]
+    const double cr = std::cos(config.rotation_rpy[0]), sr = std::sin(config.rotation_rpy[0]);
+    const double cp = std::cos(config.rotation_rpy[1]), sp = std::sin(config.rotation_rpy[1]);
+    const double cy = std::cos(config.rotation_rpy[2]), sy = std::sin(config.rotation_rpy[2]);
+    const double r[3][3] = { { cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr },
+                             { sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr },
+                             { -sp,     cp * sr,                cp * cr } };
+    const std::array<double, 3>& p = config.translation;
+    const double px[3][3] = { { 0.0, -p[2], p[1] }, { p[2], 0.0, -p[0] }, { -p[1], p[0], 0.0 } };
+    transform_.fill(0.0);
+    for (std::size_t i = 0; i < 3; i++)
+    {
+      for (std::size_t j = 0; j < 3; j++)
+      {
+        transform_[i * 6 + j]           = r[i][j];
+        transform_[(i + 3) * 6 + j + 3] = r[i][j];
+        double pr = 0.0;
+        for (std::size_t k = 0; k < 3; k++)
+        {
+          pr += px[i][k] * r[k][j];
+        }
+        transform_[(i + 3) * 6 + j] = pr;
+      }
+    }
+    bias_.fill(0.0);
+    output_.fill(0.0);
+    saturated_.reset();
+    first_ = true;
+  }
+
+  const WrenchProcessingConfig& config() const
+  {
+    return config_;
+  }
+
+  void update(const double* force, const double* torque)
+  {
+    std::array<double, 6> raw;
+    for (std::size_t i = 0; i < 3; i++)
+    {
+      raw[i]     = force[i];
+      raw[i + 3] = torque[i];
+    }
+
+    for (std::size_t i = 0; i < 6; i++)
+    {
+      const double limit = i < 3 ? config_.force_limit : config_.torque_limit;
+      saturated_[i] = limit > 0.0 && std::fabs(raw[i]) >= limit;
+    }
+
+    // transposed direct form II, initialized at the steady state of the first sample
+    std::array<double, 6> filtered;
+    for (std::size_t i = 0; i < 6; i++)
+    {
+      if (first_)
+      {
+        z2_[i] = (b_[2] - a_[1]) * raw[i];
+        z1_[i] = (b_[1] - a_[0]) * raw[i] + z2_[i];
+      }
+      filtered[i] = b_[0] * raw[i] + z1_[i];
+      z1_[i] = b_[1] * raw[i] - a_[0] * filtered[i] + z2_[i];
+      z2_[i] = b_[2] * raw[i] - a_[1] * filtered[i];
+    }
+    first_ = false;
+
+    if (tare_request_.exchange(false, std::memory_order_acq_rel))
+    {
+      bias_ = filtered;
+    }
+
+    for (std::size_t i = 0; i < 6; i++)
+    {
+      double v = 0.0;
+      for (std::size_t j = 0; j < 6; j++)
+      {
+        v += transform_[i * 6 + j] * (filtered[j] - bias_[j]);
+      }
+      output_[i] = v;
+    }
+  }
+
+  void tare()
+  {
+    tare_request_.store(true, std::memory_order_release);
+  }
+
+  /**
+   * @brief The processed wrench: force [0..2] and torque [3..5], in the output frame
+   */
+  const double* force() const
+  {
+    return output_.data();
+  }
+  const double* torque() const
+  {
+    return output_.data() + 3;
+  }
+  const std::array<double, 6>& bias() const
+  {
+    return bias_;
+  }
+  /**
+   * @return the axes of the raw wrench (fx, fy, fz, tx, ty, tz) at or beyond the limit, in the last update()
+   */
+  std::bitset<6> saturated() const
+  {
+    return saturated_;
+  }
+
+private:
+  WrenchProcessingConfig        config_;
+  double                        sampling_period_;
+  std::array<double, 3>         b_;
+  std::array<double, 2>         a_;
+  std::array<double, 6>         z1_;
+  std::array<double, 6>         z2_;
+  std::array<double, 36>        transform_;  // row-major
+  std::array<double, 6>         bias_;
+  std::array<double, 6>         output_;
+  std::bitset<6>                saturated_;
+  bool                          first_;
+  std::atomic<bool>             tare_request_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_INTERNAL_WRENCH_PROCESSING_H
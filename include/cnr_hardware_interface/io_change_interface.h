@@ -0,0 +1,111 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_IO_CHANGE_INTERFACE_H
+#define CNR_HARDWARE_INTERFACE_IO_CHANGE_INTERFACE_H
+
+#include <cassert>
+#include <string>
+#include <utility>
+#include <hardware_interface/internal/hardware_resource_manager.h>
+#include <cnr_hardware_interface/internal/io_change.h>
+
+namespace hardware_interface
+{
+
+/**
+ * @brief Read-only access to the I/O changes detected by the RobotHW in the last read(). The channel indexes are
+ * the ones of the DigitalStateInterface/AnalogStateInterface names, in registration order (see getDigitalName()).
+ */
+class IOChangeHandle
+{
+public:
+  IOChangeHandle() : name_(), changes_(nullptr), buffer_(nullptr) {}
+
+  IOChangeHandle(const std::string& name, const cnr_hardware_interface::IOChangeDetector* changes,
+                 const cnr_hardware_interface::HardwareBuffer* buffer)
+    : name_(name), changes_(changes), buffer_(buffer)
+  {
+    if (!changes || !buffer)
+    {
+      throw HardwareInterfaceException("Cannot create handle '" + name + "'. IO change data pointer is null.");
+    }
+  }
+
+  const std::string& getName() const&
+  {
+    return name_;
+  }
+  std::string getName() const&&
+  {
+    return name_;
+  }
+  const cnr_hardware_interface::IOChangeDetector& getChanges() const
+  {
+    assert(changes_);
+    return *changes_;
+  }
+  const std::string& getDigitalName(const std::size_t channel) const
+  {
+    assert(buffer_);
+    return buffer_->digitalNames().at(channel);
+  }
+  const std::string& getAnalogName(const std::size_t channel) const
+  {
+    assert(buffer_);
+    return buffer_->analogNames().at(channel);
+  }
+
+  template<typename F>
+  void forEachDigitalChange(F&& f) const
+  {
+    getChanges().forEachDigitalChange(std::forward<F>(f));
+  }
+  template<typename F>
+  void forEachAnalogChange(F&& f) const
+  {
+    getChanges().forEachAnalogChange(std::forward<F>(f));
+  }
+
+private:
+  std::string                                     name_;
+  const cnr_hardware_interface::IOChangeDetector* changes_;
+  const cnr_hardware_interface::HardwareBuffer*   buffer_;
+};
+
+class IOChangeInterface : public HardwareResourceManager<IOChangeHandle> {};
+
+}  // namespace hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_IO_CHANGE_INTERFACE_H
@@ -59,12 +59,21 @@ public:
     }
   }
 
-  void setCommand(geometry_msgs::Pose command)
+  void setCommand(const geometry_msgs::Pose& command)
   {
     assert(cmd_);
     *cmd_ = command;
   }
-  geometry_msgs::Pose getCommand() const
+  const geometry_msgs::Pose& getCommand() const
+  {
+    assert(cmd_);
+    return *cmd_;
+  }
+
+  /**
+   * \return the storage of the command, to be modified in place (no copy of the whole message)
+   */
+  geometry_msgs::Pose& command() const
   {
     assert(cmd_);
     return *cmd_;
@@ -63,7 +63,11 @@ public:
     }
   }
 
-  std::string getName() const
+  const std::string& getName() const&
+  {
+    return name_;
+  }
+  std::string getName() const&&
   {
     return name_;
   }
@@ -72,6 +76,11 @@ public:
     assert(value_);
     return value_;
   }
+  const geometry_msgs::Pose& getValue()  const
+  {
+    assert(value_);
+    return *value_;
+  }
 
 
 private:
@@ -37,7 +37,9 @@
 #define CNR_HARDWARE_INTERFACE_POSVELEFF_COMMAND_INTERFACE_H
 
 #include <cassert>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <hardware_interface/internal/hardware_resource_manager.h>
 #include <cnr_hardware_interface/veleff_command_interface.h>
 
@@ -55,9 +57,11 @@ public:
    * \param cmd_pos A pointer to the storage for this joint's output command position
    * \param cmd_vel A pointer to the storage for this joint's output command velocity
    * \param eff_cmd A pointer to the storage for this joint's output command acceleration
+   * \param cmd_seq An optional pointer to a counter, incremented at each command
    */
-  PosVelEffJointHandle(const JointStateHandle& js, double* cmd_pos, double* cmd_vel, double* cmd_eff)
-    : VelEffJointHandle(js, cmd_vel, cmd_eff), cmd_pos_(cmd_pos)
+  PosVelEffJointHandle(const JointStateHandle& js, double* cmd_pos, double* cmd_vel, double* cmd_eff,
+                       uint64_t* cmd_seq = nullptr)
+    : VelEffJointHandle(js, cmd_vel, cmd_eff, cmd_seq), cmd_pos_(cmd_pos)
   {
     if (!cmd_pos)
     {
@@ -77,6 +81,7 @@ public:
   {
     assert(cmd_pos_);
     *cmd_pos_ = cmd_pos;
+    touch();
   }
   double getCommandPosition() const
   {
@@ -84,11 +89,71 @@ public:
     return *cmd_pos_;
   }
 
+  double* getCommandPositionPtr() const
+  {
+    return cmd_pos_;
+  }
+
 private:
   double* cmd_pos_;
 };
 
-class PosVelEffJointInterface : public HardwareResourceManager<PosVelEffJointHandle, ClaimResources> {};
+/** \brief A handle used to read and command a group of joints at once, see VelEffJointGroupHandle */
+class PosVelEffJointGroupHandle : public VelEffJointGroupHandle
+{
+public:
+  PosVelEffJointGroupHandle() = default;
+
+  explicit PosVelEffJointGroupHandle(const std::vector<PosVelEffJointHandle>& handles)
+    : VelEffJointGroupHandle(std::vector<VelEffJointHandle>(handles.begin(), handles.end()))
+  {
+    std::vector<double*> cmd_pos;
+    for (const PosVelEffJointHandle& h : handles)
+    {
+      cmd_pos.push_back(h.getCommandPositionPtr());
+    }
+    cmd_pos_ = cnr_hardware_interface::JointGroupColumn<double>(cmd_pos);
+  }
+
+  bool contiguous() const
+  {
+    return VelEffJointGroupHandle::contiguous() && cmd_pos_.contiguous();
+  }
+
+  using VelEffJointGroupHandle::setCommands;
+
+  void setCommands(const double* cmd_pos, const double* cmd_vel, const double* cmd_eff) const
+  {
+    if (cmd_pos)
+    {
+      cmd_pos_.set(cmd_pos);
+    }
+    VelEffJointGroupHandle::setCommands(cmd_vel, cmd_eff);
+  }
+
+  void getCommandPositions(double* cmd_pos) const
+  {
+    cmd_pos_.get(cmd_pos);
+  }
+
+private:
+  cnr_hardware_interface::JointGroupColumn<double> cmd_pos_;
+};
+
+class PosVelEffJointInterface : public HardwareResourceManager<PosVelEffJointHandle, ClaimResources>
+{
+public:
+  /** \brief It gets (and claims) the handles of all the joints, in the given order. */
+  PosVelEffJointGroupHandle getGroupHandle(const std::vector<std::string>& names)
+  {
+    std::vector<PosVelEffJointHandle> handles;
+    for (const std::string& name : names)
+    {
+      handles.push_back(getHandle(name));
+    }
+    return PosVelEffJointGroupHandle(handles);
+  }
+};
 
 }  // namespace hardware_interface
 
@@ -0,0 +1,186 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_RT_EXECUTOR_H
+#define CNR_HARDWARE_INTERFACE_RT_EXECUTOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+#include <ros/ros.h>
+#include <cnr_hardware_interface/cnr_robot_hw.h>
+#include <cnr_hardware_interface/internal/diagnostics.h>
+
+namespace cnr_hardware_interface
+{
+
+struct RTExecutorOptions
+{
+  RTExecutorOptions() : period(0.0), priority(0), lock_memory(false), window_dim(1000), start_ns(0) {}
+
+  double           period;       // [s], if 0 the RobotHW::getSamplingPeriod() of the first RobotHW is used
+  int              priority;     // SCHED_FIFO priority (1-99), if 0 the thread keeps the default scheduler
+  std::vector<int> cpus;         // CPU affinity, if empty the thread can run on any CPU
+  bool             lock_memory;  // mlockall(MCL_CURRENT | MCL_FUTURE) before starting the loop
+  int              window_dim;   // samples of the MainThreadSharedData windows
+  int64_t          start_ns;     // CLOCK_MONOTONIC time of the cycle 0 [ns], if 0 the loop starts immediately
+};
+
+/**
+ * @brief A RobotHW run by an executor every 'divisor' cycles of the executor, at the cycles where
+ * (cycle % divisor) == (phase % divisor)
+ */
+struct RTMember
+{
+  explicit RTMember(const RobotHWSharedPtr& robot_hw, const unsigned int div = 1, const unsigned int ph = 0)
+    : hw(robot_hw), divisor(div > 0 ? div : 1), phase(ph % (div > 0 ? div : 1)) {}
+
+  RobotHWSharedPtr hw;
+  unsigned int     divisor;
+  unsigned int     phase;
+};
+
+/**
+ * @brief The RT loop of one or more RobotHW: initRT(), then, at each period, read() of all the RobotHW due in the
+ * cycle, update(), and write() of all the RobotHW due in the cycle.
+ *
+ * The wake-ups are absolute deadlines on CLOCK_MONOTONIC (clock_nanosleep(TIMER_ABSTIME)), therefore the period
+ * does not drift with the computation time. If a cycle overruns, the missed deadlines are skipped (not recovered
+ * with a burst of cycles) and counted. At each cycle the wake-up latency, the actual cycle time, the computation
+ * time and the missed cycles are pushed in the MainThreadSharedData, that the diagnostics read without locking.
+ *
+ * The update function is usually a wrapper of controller_manager::ControllerManager::update(), it can be empty.
+ */
+class RTExecutor
+{
+public:
+  typedef std::function<void(const ros::Time&, const ros::Duration&)> UpdateFcn;
+
+  RTExecutor(const RobotHWSharedPtr& hw, const UpdateFcn& update, const RTExecutorOptions& options = RTExecutorOptions());
+  RTExecutor(const std::vector<RTMember>& members, const UpdateFcn& update,
+             const RTExecutorOptions& options = RTExecutorOptions());
+  ~RTExecutor();
+
+  RTExecutor(const RTExecutor&) = delete;
+  RTExecutor& operator=(const RTExecutor&) = delete;
+
+  /**
+   * @brief It spawns the RT thread, and waits until it is configured (scheduler, affinity) and initRT() returned
+   * @return false if the thread cannot be configured as requested, or if initRT() fails. See what.
+   */
+  bool start(std::string* what = nullptr);
+  void stop();
+  bool isRunning() const;
+
+  uint64_t cycles() const;
+  uint64_t missedCycles() const;
+  std::shared_ptr<MainThreadSharedData> sharedData() const;
+
+private:
+  void loop(std::promise<bool>* started);
+  bool configureThread(std::string& what);
+
+  std::vector<RTMember>                 members_;
+  std::vector<ros::Duration>            member_periods_;
+  UpdateFcn                             update_;
+  RTExecutorOptions                     options_;
+  std::shared_ptr<MainThreadSharedData> data_;
+
+  std::thread                           thread_;
+  std::atomic<bool>                     stop_;
+  std::atomic<bool>                     running_;
+  std::string                           start_error_;  // written by the RT thread before the promise is set
+  std::atomic<uint64_t>                 cycles_;
+  std::atomic<uint64_t>                 missed_cycles_;
+};
+
+/**
+ * @brief Many RobotHW of the same process, scheduled on a few RT threads (the groups).
+ *
+ * Each group is an RTExecutor with its own period, priority, affinity and update function; each RobotHW is added
+ * to a group with a period divisor and a phase offset (e.g. a F/T sensor at 1/4 of the arm rate, shifted so that
+ * it does not share the cycle with the gripper). The reads of a cycle are batched before the update, and the
+ * writes after it. All the groups share the same time origin, so that their cycles stay aligned.
+ */
+class CombinedRTExecutor
+{
+public:
+  CombinedRTExecutor() = default;
+  ~CombinedRTExecutor();
+
+  CombinedRTExecutor(const CombinedRTExecutor&) = delete;
+  CombinedRTExecutor& operator=(const CombinedRTExecutor&) = delete;
+
+  /**
+   * @return false if the group already exists, or the executor is running
+   */
+  bool addGroup(const std::string& group, const RTExecutor::UpdateFcn& update,
+                const RTExecutorOptions& options = RTExecutorOptions());
+  /**
+   * @return false if the group does not exist, or the executor is running
+   */
+  bool addMember(const std::string& group, const RTMember& member);
+
+  /**
+   * @brief It starts all the groups. If one of them fails, the others are stopped.
+   */
+  bool start(std::string* what = nullptr);
+  void stop();
+
+  /**
+   * @return the timing of the group, nullptr if the group is not running
+   */
+  std::shared_ptr<MainThreadSharedData> sharedData(const std::string& group) const;
+
+private:
+  struct Group
+  {
+    RTExecutor::UpdateFcn       update;
+    RTExecutorOptions           options;
+    std::vector<RTMember>       members;
+    std::unique_ptr<RTExecutor> executor;
+  };
+  std::map<std::string, Group> groups_;
+  bool                         running_ = false;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_RT_EXECUTOR_H
@@ -0,0 +1,183 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CNR_HARDWARE_INTERFACE_SHM_STATE_H
+#define CNR_HARDWARE_INTERFACE_SHM_STATE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cnr_hardware_interface/cnr_robot_hw_status.h>
+#include <cnr_hardware_interface/hardware_buffer.h>
+#include <cnr_hardware_interface/internal/phase_timing.h>
+
+namespace cnr_hardware_interface
+{
+
+/**
+ * @brief Layout of the shared-memory segment (POSIX shm) of the RobotHW state.
+ *
+ * [ShmStateHeader][names: (joints + analogs + force_torques + digitals) x kNameSize chars]
+ * [data: words_number x uint64_t]
+ *
+ * The data words are published under the sequence counter of the header (a seqlock): the writer (the RT thread)
+ * never waits for the readers, and the readers retry if the data changed while they were copying it. The doubles
+ * are stored as their bit pattern. The order of the data, in words, is:
+ *   cycle, stamp_ns, state, (last, mean, max) [s] of each RTPhase,
+ *   position, velocity, effort, command position, command velocity, command effort  (joints words each),
+ *   analog value, analog command (analogs words each),
+ *   wrench, wrench command (6 x force_torques words each: force x, y, z, torque x, y, z of each sensor),
+ *   digital value, digital command ((digitals + 63) / 64 words each, bit i of word i/64)
+ */
+struct ShmStateHeader
+{
+  static constexpr uint32_t kMagic    = 0x434e5248;  // "CNRH"
+  static constexpr uint32_t kVersion  = 2;
+  static constexpr uint32_t kNameSize = 64;
+
+  std::atomic<uint32_t> magic;  // written last by the publisher, when the segment is ready
+  uint32_t              version;
+  uint32_t              joints;
+  uint32_t              analogs;
+  uint32_t              force_torques;
+  uint32_t              digitals;
+  uint32_t              words_number;
+  alignas(64) std::atomic<uint64_t> seq;
+};
+
+/**
+ * @brief A consistent copy of the segment
+ */
+struct ShmStateSnapshot
+{
+  uint64_t                 cycle;
+  uint64_t                 stamp_ns;
+  StatusHw                 state;
+  WindowStatistics         timing[PhaseTimingStats::kPhases];  // only last, mean and max are filled
+  std::vector<double>      position;
+  std::vector<double>      velocity;
+  std::vector<double>      effort;
+  std::vector<double>      command_position;
+  std::vector<double>      command_velocity;
+  std::vector<double>      command_effort;
+  std::vector<double>      analog;
+  std::vector<double>      analog_command;
+  std::vector<double>      wrench;          // 6 per sensor, as HardwareBuffer::wrench()
+  std::vector<double>      wrench_command;
+  std::vector<bool>        digital;
+  std::vector<bool>        digital_command;
+};
+
+/**
+ * @brief Writer side, owned by the RobotHW: create() is not RT-safe, publish() is (a copy of the buffer in the
+ * mapped memory, no system call).
+ */
+class ShmStatePublisher
+{
+public:
+  ShmStatePublisher();
+  ~ShmStatePublisher();
+
+  ShmStatePublisher(const ShmStatePublisher&) = delete;
+  ShmStatePublisher& operator=(const ShmStatePublisher&) = delete;
+
+  /**
+   * @param name the POSIX shm name, e.g. "/cnr_hw_ur5" (the segment is unlinked by the destructor)
+   */
+  bool create(const std::string& name, const HardwareBuffer& buffer, std::string* what = nullptr);
+  void close();
+  bool isOpen() const
+  {
+    return header_ != nullptr;
+  }
+
+  void publish(const uint64_t cycle, const StatusHw& state, const PhaseTimingStats& timing,
+               const HardwareBuffer& buffer);
+
+private:
+  std::string            name_;
+  void*                  map_;
+  std::size_t            size_;
+  ShmStateHeader*        header_;
+  std::atomic<uint64_t>* words_;
+};
+
+/**
+ * @brief Reader side, for the external monitors. It never writes in the segment.
+ */
+class ShmStateReader
+{
+public:
+  ShmStateReader();
+  ~ShmStateReader();
+
+  ShmStateReader(const ShmStateReader&) = delete;
+  ShmStateReader& operator=(const ShmStateReader&) = delete;
+
+  /**
+   * @return false if the segment does not exist, or it is not (yet) ready
+   */
+  bool open(const std::string& name, std::string* what = nullptr);
+  void close();
+  bool isOpen() const
+  {
+    return header_ != nullptr;
+  }
+
+  const std::vector<std::string>& jointNames() const { return joint_names_; }
+  const std::vector<std::string>& analogNames() const { return analog_names_; }
+  const std::vector<std::string>& forceTorqueNames() const { return ft_names_; }
+  const std::vector<std::string>& digitalNames() const { return digital_names_; }
+
+  /**
+   * @return false if no cycle has been published yet
+   */
+  bool read(ShmStateSnapshot& snapshot) const;
+
+private:
+  void*                        map_;
+  std::size_t                  size_;
+  const ShmStateHeader*        header_;
+  const std::atomic<uint64_t>* words_;
+  std::vector<std::string>     joint_names_;
+  std::vector<std::string>     analog_names_;
+  std::vector<std::string>     ft_names_;
+  std::vector<std::string>     digital_names_;
+  mutable std::vector<uint64_t> copy_;
+};
+
+}  // namespace cnr_hardware_interface
+
+#endif  // CNR_HARDWARE_INTERFACE_SHM_STATE_H
@@ -59,12 +59,21 @@ public:
     }
   }
 
-  void setCommand(geometry_msgs::Twist command)
+  void setCommand(const geometry_msgs::Twist& command)
   {
     assert(cmd_);
     *cmd_ = command;
   }
-  geometry_msgs::Twist getCommand() const
+  const geometry_msgs::Twist& getCommand() const
+  {
+    assert(cmd_);
+    return *cmd_;
+  }
+
+  /**
+   * \return the storage of the command, to be modified in place (no copy of the whole message)
+   */
+  geometry_msgs::Twist& command() const
   {
     assert(cmd_);
     return *cmd_;
@@ -38,9 +38,12 @@
 
 #include <iostream>
 #include <cassert>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <hardware_interface/internal/hardware_resource_manager.h>
 #include <hardware_interface/joint_state_interface.h>
+#include <cnr_hardware_interface/internal/joint_group.h>
 
 namespace hardware_interface
 {
@@ -49,15 +52,17 @@ namespace hardware_interface
 class VelEffJointHandle : public JointStateHandle
 {
 public:
-  VelEffJointHandle() : JointStateHandle(), cmd_vel_(0), cmd_eff_(0) {}
+  VelEffJointHandle() : JointStateHandle(), cmd_vel_(0), cmd_eff_(0), cmd_seq_(0) {}
 
   /**
    * \param js This joint's state handle
    * \param cmd_vel A pointer to the storage for this joint's output command velocity
    * \param cmd_eff A pointer to the storage for this joint's output command effort
+   * \param cmd_seq An optional pointer to a counter, incremented at each command (see the command watchdog of the
+   * cnr_hardware_interface::RobotHW)
    */
-  VelEffJointHandle(const JointStateHandle& js, double* cmd_vel, double* cmd_eff)
-    : JointStateHandle(js), cmd_vel_(cmd_vel), cmd_eff_(cmd_eff)
+  VelEffJointHandle(const JointStateHandle& js, double* cmd_vel, double* cmd_eff, uint64_t* cmd_seq = nullptr)
+    : JointStateHandle(js), cmd_vel_(cmd_vel), cmd_eff_(cmd_eff), cmd_seq_(cmd_seq)
   {
     if (!cmd_vel)
     {
@@ -81,11 +86,13 @@ public:
   {
     assert(cmd_vel_);
     *cmd_vel_ = cmd_vel;
+    touch();
   }
   void setCommandEffort(double cmd_eff)
   {
     assert(cmd_eff_);
     *cmd_eff_ = cmd_eff;
+    touch();
   }
 
   double getCommandVelocity()     const
@@ -99,9 +106,152 @@ public:
     return *cmd_eff_;
   }
 
+  double* getCommandVelocityPtr() const
+  {
+    return cmd_vel_;
+  }
+  double* getCommandEffortPtr() const
+  {
+    return cmd_eff_;
+  }
+  uint64_t* getCommandSeqPtr() const
+  {
+    return cmd_seq_;
+  }
+
+protected:
+  void touch()
+  {
+    if (cmd_seq_)
+    {
+      ++*cmd_seq_;
+    }
+  }
+
+private:
+  double*   cmd_vel_;
+  double*   cmd_eff_;
+  uint64_t* cmd_seq_;
+};
+
+
+/** \brief A handle used to read and command a group of joints at once.
+ *
+ * The values are exchanged as arrays, ordered as the handles given to the constructor. If the storage of the joints
+ * is contiguous (e.g. the handles are created by cnr_hardware_interface::HardwareBuffer) the copies are vectorized.
+ * A null array is skipped, e.g. setCommands(nullptr, eff) leaves the command velocities untouched.
+ */
+class VelEffJointGroupHandle
+{
+public:
+  VelEffJointGroupHandle() = default;
+
+  explicit VelEffJointGroupHandle(const std::vector<VelEffJointHandle>& handles)
+  {
+    std::vector<const double*> pos, vel, eff;
+    std::vector<double*> cmd_vel, cmd_eff;
+    for (const VelEffJointHandle& h : handles)
+    {
+      names_.push_back(h.getName());
+      pos.push_back(h.getPositionPtr());
+      vel.push_back(h.getVelocityPtr());
+      eff.push_back(h.getEffortPtr());
+      cmd_vel.push_back(h.getCommandVelocityPtr());
+      cmd_eff.push_back(h.getCommandEffortPtr());
+      if (h.getCommandSeqPtr())
+      {
+        cmd_seq_.push_back(h.getCommandSeqPtr());
+      }
+    }
+    pos_     = cnr_hardware_interface::JointGroupColumn<const double>(pos);
+    vel_     = cnr_hardware_interface::JointGroupColumn<const double>(vel);
+    eff_     = cnr_hardware_interface::JointGroupColumn<const double>(eff);
+    cmd_vel_ = cnr_hardware_interface::JointGroupColumn<double>(cmd_vel);
+    cmd_eff_ = cnr_hardware_interface::JointGroupColumn<double>(cmd_eff);
+  }
+
+  const std::vector<std::string>& getNames() const
+  {
+    return names_;
+  }
+  std::size_t size() const
+  {
+    return names_.size();
+  }
+
+  /**
+   * \return true if all the states and commands of the group are stored in contiguous arrays
+   */
+  bool contiguous() const
+  {
+    return pos_.contiguous() && vel_.contiguous() && eff_.contiguous()
+        && cmd_vel_.contiguous() && cmd_eff_.contiguous();
+  }
+
+  /**
+   * \note Any call refreshes the commands of the whole group for the command watchdog, even with null arrays
+   */
+  void setCommands(const double* cmd_vel, const double* cmd_eff) const
+  {
+    if (cmd_vel)
+    {
+      cmd_vel_.set(cmd_vel);
+    }
+    if (cmd_eff)
+    {
+      cmd_eff_.set(cmd_eff);
+    }
+    for (uint64_t* seq : cmd_seq_)
+    {
+      ++*seq;
+    }
+  }
+
+  void getPositions(double* pos) const
+  {
+    pos_.get(pos);
+  }
+  void getVelocities(double* vel) const
+  {
+    vel_.get(vel);
+  }
+  void getEfforts(double* eff) const
+  {
+    eff_.get(eff);
+  }
+  void getCommandVelocities(double* cmd_vel) const
+  {
+    cmd_vel_.get(cmd_vel);
+  }
+  void getCommandEfforts(double* cmd_eff) const
+  {
+    cmd_eff_.get(cmd_eff);
+  }
+
+  /**
+   * \return the pointer to the first element, or nullptr if the storage is not contiguous
+   */
+  const double* positionData() const
+  {
+    return pos_.data();
+  }
+  const double* velocityData() const
+  {
+    return vel_.data();
+  }
+  const double* effortData() const
+  {
+    return eff_.data();
+  }
+
 private:
-  double* cmd_vel_;
-  double* cmd_eff_;
+  std::vector<std::string>                               names_;
+  cnr_hardware_interface::JointGroupColumn<const double> pos_;
+  cnr_hardware_interface::JointGroupColumn<const double> vel_;
+  cnr_hardware_interface::JointGroupColumn<const double> eff_;
+  cnr_hardware_interface::JointGroupColumn<double>       cmd_vel_;
+  cnr_hardware_interface::JointGroupColumn<double>       cmd_eff_;
+  std::vector<uint64_t*>                                 cmd_seq_;
 };
 
 
@@ -113,7 +263,20 @@ private:
  * \note Getting a joint handle through the getHandle() method \e will claim that resource.
  *
  */
-class VelEffJointInterface : public HardwareResourceManager<VelEffJointHandle, ClaimResources> {};
+class VelEffJointInterface : public HardwareResourceManager<VelEffJointHandle, ClaimResources>
+{
+public:
+  /** \brief It gets (and claims) the handles of all the joints, in the given order. */
+  VelEffJointGroupHandle getGroupHandle(const std::vector<std::string>& names)
+  {
+    std::vector<VelEffJointHandle> handles;
+    for (const std::string& name : names)
+    {
+      handles.push_back(getHandle(name));
+    }
+    return VelEffJointGroupHandle(handles);
+  }
+};
 
 }  // namespace hardware_interface
 
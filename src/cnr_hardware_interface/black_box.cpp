@@ -0,0 +1,462 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>  // NOLINT
+#include <cnr_hardware_interface/black_box.h>
+
+namespace cnr_hardware_interface
+{
+
+namespace
+{
+
+const char kMagic[8] = "CNRHWBB";
+
+constexpr std::size_t kIntColumns = 3;  // cycle, stamp_ns, state
+constexpr std::size_t kPhases     = PhaseTimingStats::kPhases;
+
+constexpr std::size_t kWrenchSize = HardwareBuffer::kWrenchSize;
+
+std::size_t doubleColumns(const std::size_t joints, const std::size_t analogs, const std::size_t force_torques)
+{
+  return kPhases + 6 * joints + 2 * analogs + 2 * kWrenchSize * force_torques;
+}
+
+std::size_t columnsOffset(const std::size_t names)
+{
+  const std::size_t end = sizeof(BlackBoxFileHeader) + names * BlackBoxFileHeader::kNameSize;
+  return (end + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+}
+
+std::size_t fileSize(const std::size_t joints, const std::size_t analogs, const std::size_t force_torques,
+                     const std::size_t digitals, const std::size_t samples)
+{
+  return columnsOffset(joints + analogs + force_torques + digitals + kPhases)
+         + samples * ((kIntColumns + doubleColumns(joints, analogs, force_torques)) * sizeof(uint64_t) + 2 * digitals);
+}
+
+uint64_t toWord(const double v)
+{
+  uint64_t w;
+  std::memcpy(&w, &v, sizeof(w));
+  return w;
+}
+
+void setError(std::string* what, const std::string& msg)
+{
+  if (what)
+  {
+    *what = msg;
+  }
+}
+
+}  // namespace
+
+BlackBoxRecorder::BlackBoxRecorder()
+  : capacity_(0), head_(0), writing_(0), trigger_(0), trigger_stamp_ns_(0), dumps_(0)
+{
+}
+
+std::size_t BlackBoxRecorder::rowSize() const
+{
+  return kIntColumns + doubleColumns(joint_names_.size(), analog_names_.size(), ft_names_.size())
+         + 2 * digital_names_.size();
+}
+
+void BlackBoxRecorder::resize(const HardwareBuffer& buffer, const std::size_t samples)
+{
+  joint_names_   = buffer.jointNames();
+  analog_names_  = buffer.analogNames();
+  ft_names_      = buffer.forceTorqueNames();
+  digital_names_ = buffer.digitalNames();
+  capacity_      = samples;
+  rows_.assign(capacity_ * rowSize(), 0);
+  head_ = 0;
+  trigger_.store(0);
+}
+
+void BlackBoxRecorder::record(const uint64_t cycle, const StatusHw& state, const PhaseTimingStats& timing,
+                              const HardwareBuffer& buffer)
+{
+  if (capacity_ == 0 || buffer.jointNumber() != joint_names_.size()
+      || buffer.forceTorqueNames().size() != ft_names_.size())
+  {
+    return;
+  }
+
+  // seq_cst: either dump() sees the row in progress and waits for it, or this sees the trigger
+  writing_.fetch_add(1);
+  if (trigger_.load() != 0)
+  {
+    writing_.fetch_add(1);
+    return;
+  }
+
+  uint64_t* row = &rows_[(head_ % capacity_) * rowSize()];
+  *row++ = cycle;
+  *row++ = monotonicNs();
+  *row++ = static_cast<uint64_t>(state);
+  for (std::size_t i = 0; i < kPhases; i++)
+  {
+    *row++ = toWord(timing.statistics(static_cast<RTPhase>(i)).last);
+  }
+  auto append = [&row](const AlignedColumn<double>& c)
+  {
+    for (std::size_t i = 0; i < c.size(); i++)
+    {
+      *row++ = toWord(c[i]);
+    }
+  };
+  append(buffer.position());
+  append(buffer.velocity());
+  append(buffer.effort());
+  append(buffer.commandPosition());
+  append(buffer.commandVelocity());
+  append(buffer.commandEffort());
+  append(buffer.analogValue());
+  append(buffer.analogCommand());
+  append(buffer.wrench());
+  append(buffer.wrenchCommand());
+  for (std::size_t i = 0; i < digital_names_.size(); i++)
+  {
+    *row++ = buffer.digitalValue()[i] ? 1U : 0U;
+  }
+  for (std::size_t i = 0; i < digital_names_.size(); i++)
+  {
+    *row++ = buffer.digitalCommand()[i] ? 1U : 0U;
+  }
+  head_++;
+  writing_.fetch_add(1);
+}
+
+void BlackBoxRecorder::trigger(const StatusHw& reason)
+{
+  uint32_t expected = 0;
+  if (trigger_.compare_exchange_strong(expected, static_cast<uint32_t>(reason) + 1))
+  {
+    trigger_stamp_ns_.store(monotonicNs());
+  }
+}
+
+bool BlackBoxRecorder::dump(const std::string& path, std::string* what)
+{
+  if (!triggered())
+  {
+    setError(what, "the recorder has not been triggered");
+    return false;
+  }
+  while (writing_.load() & 1U)
+  {
+    std::this_thread::yield();
+  }
+
+  const std::size_t samples = std::min<uint64_t>(head_, capacity_);
+  const std::size_t first   = head_ - samples;
+  const std::size_t rs      = rowSize();
+  const std::size_t nj = joint_names_.size();
+  const std::size_t na = analog_names_.size();
+  const std::size_t nf = ft_names_.size();
+  const std::size_t nd = digital_names_.size();
+  const std::size_t size = fileSize(nj, na, nf, nd, samples);
+
+  auto rearm = [this]()
+  {
+    head_ = 0;
+    trigger_.store(0);
+  };
+
+  int fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    setError(what, "open('" + path + "') failed: " + std::strerror(errno));
+    rearm();
+    return false;
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+  {
+    setError(what, "ftruncate('" + path + "') failed: " + std::strerror(errno));
+    ::close(fd);
+    rearm();
+    return false;
+  }
+  void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+  {
+    setError(what, "mmap('" + path + "') failed: " + std::strerror(errno));
+    rearm();
+    return false;
+  }
+
+  char* base = static_cast<char*>(map);
+  BlackBoxFileHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(header.magic));
+  header.version          = BlackBoxFileHeader::kVersion;
+  header.joints           = static_cast<uint32_t>(nj);
+  header.analogs          = static_cast<uint32_t>(na);
+  header.force_torques    = static_cast<uint32_t>(nf);
+  header.digitals         = static_cast<uint32_t>(nd);
+  header.phases           = static_cast<uint32_t>(kPhases);
+  header.trigger_state    = trigger_.load() - 1;
+  header.samples          = samples;
+  header.trigger_stamp_ns = trigger_stamp_ns_.load();
+  std::memcpy(base, &header, sizeof(header));
+
+  char* n = base + sizeof(BlackBoxFileHeader);
+  std::memset(n, 0, (nj + na + nf + nd + kPhases) * BlackBoxFileHeader::kNameSize);
+  auto names = [&n](const std::string& s)
+  {
+    std::strncpy(n, s.c_str(), BlackBoxFileHeader::kNameSize - 1);
+    n += BlackBoxFileHeader::kNameSize;
+  };
+  std::for_each(joint_names_.begin(), joint_names_.end(), names);
+  std::for_each(analog_names_.begin(), analog_names_.end(), names);
+  std::for_each(ft_names_.begin(), ft_names_.end(), names);
+  std::for_each(digital_names_.begin(), digital_names_.end(), names);
+  for (std::size_t i = 0; i < kPhases; i++)
+  {
+    names(to_string(static_cast<RTPhase>(i)));
+  }
+
+  // transpose the rows in columns, from the oldest sample
+  char* c = base + columnsOffset(nj + na + nf + nd + kPhases);
+  const std::size_t words = kIntColumns + doubleColumns(nj, na, nf);
+  for (std::size_t w = 0; w < words; w++)
+  {
+    uint64_t* col = reinterpret_cast<uint64_t*>(c);
+    for (std::size_t k = 0; k < samples; k++)
+    {
+      col[k] = rows_[((first + k) % capacity_) * rs + w];
+    }
+    c += samples * sizeof(uint64_t);
+  }
+  for (std::size_t w = words; w < rs; w++)
+  {
+    uint8_t* col = reinterpret_cast<uint8_t*>(c);
+    for (std::size_t k = 0; k < samples; k++)
+    {
+      col[k] = static_cast<uint8_t>(rows_[((first + k) % capacity_) * rs + w]);
+    }
+    c += samples;
+  }
+
+  ::msync(map, size, MS_SYNC);
+  ::munmap(map, size);
+  dumps_.fetch_add(1, std::memory_order_relaxed);
+  rearm();
+  return true;
+}
+
+BlackBoxFile::BlackBoxFile() : map_(nullptr), size_(0), header_(nullptr), columns_(nullptr)
+{
+}
+
+BlackBoxFile::~BlackBoxFile()
+{
+  close();
+}
+
+bool BlackBoxFile::open(const std::string& path, std::string* what)
+{
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    setError(what, "open('" + path + "') failed: " + std::strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(BlackBoxFileHeader))
+  {
+    setError(what, "'" + path + "' is not a black box file");
+    ::close(fd);
+    return false;
+  }
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+  {
+    setError(what, "mmap('" + path + "') failed: " + std::strerror(errno));
+    return false;
+  }
+
+  const char* base = static_cast<const char*>(map);
+  const BlackBoxFileHeader* header = reinterpret_cast<const BlackBoxFileHeader*>(base);
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != BlackBoxFileHeader::kVersion
+      || header->phases != kPhases
+      || size < fileSize(header->joints, header->analogs, header->force_torques, header->digitals, header->samples))
+  {
+    setError(what, "'" + path + "' is not a black box file, or it has an unknown version");
+    ::munmap(map, size);
+    return false;
+  }
+
+  const char* n = base + sizeof(BlackBoxFileHeader);
+  auto names = [&n](std::vector<std::string>& v, const std::size_t count)
+  {
+    v.clear();
+    for (std::size_t i = 0; i < count; i++)
+    {
+      v.push_back(std::string(n, ::strnlen(n, BlackBoxFileHeader::kNameSize)));
+      n += BlackBoxFileHeader::kNameSize;
+    }
+  };
+  names(joint_names_, header->joints);
+  names(analog_names_, header->analogs);
+  names(ft_names_, header->force_torques);
+  names(digital_names_, header->digitals);
+  names(phase_names_, header->phases);
+
+  map_     = map;
+  size_    = size;
+  header_  = header;
+  columns_ = base + columnsOffset(header->joints + header->analogs + header->force_torques + header->digitals
+                                  + header->phases);
+  return true;
+}
+
+void BlackBoxFile::close()
+{
+  if (map_)
+  {
+    ::munmap(map_, size_);
+  }
+  map_     = nullptr;
+  size_    = 0;
+  header_  = nullptr;
+  columns_ = nullptr;
+  joint_names_.clear();
+  analog_names_.clear();
+  ft_names_.clear();
+  digital_names_.clear();
+  phase_names_.clear();
+}
+
+const uint64_t* BlackBoxFile::cycle() const
+{
+  return reinterpret_cast<const uint64_t*>(columns_);
+}
+
+const uint64_t* BlackBoxFile::stamp() const
+{
+  return cycle() + samples();
+}
+
+const uint64_t* BlackBoxFile::state() const
+{
+  return cycle() + 2 * samples();
+}
+
+const double* BlackBoxFile::doubleColumn(const std::size_t i) const
+{
+  return reinterpret_cast<const double*>(columns_ + (kIntColumns + i) * samples() * sizeof(uint64_t));
+}
+
+const double* BlackBoxFile::phase(const std::size_t i) const
+{
+  return doubleColumn(i);
+}
+
+const double* BlackBoxFile::position(const std::size_t joint) const
+{
+  return doubleColumn(kPhases + joint);
+}
+
+const double* BlackBoxFile::velocity(const std::size_t joint) const
+{
+  return doubleColumn(kPhases + header_->joints + joint);
+}
+
+const double* BlackBoxFile::effort(const std::size_t joint) const
+{
+  return doubleColumn(kPhases + 2 * header_->joints + joint);
+}
+
+const double* BlackBoxFile::commandPosition(const std::size_t joint) const
+{
+  return doubleColumn(kPhases + 3 * header_->joints + joint);
+}
+
+const double* BlackBoxFile::commandVelocity(const std::size_t joint) const
+{
+  return doubleColumn(kPhases + 4 * header_->joints + joint);
+}
+
+const double* BlackBoxFile::commandEffort(const std::size_t joint) const
+{
+  return doubleColumn(kPhases + 5 * header_->joints + joint);
+}
+
+const double* BlackBoxFile::analogValue(const std::size_t analog) const
+{
+  return doubleColumn(kPhases + 6 * header_->joints + analog);
+}
+
+const double* BlackBoxFile::analogCommand(const std::size_t analog) const
+{
+  return doubleColumn(kPhases + 6 * header_->joints + header_->analogs + analog);
+}
+
+const double* BlackBoxFile::wrench(const std::size_t sensor, const std::size_t component) const
+{
+  return doubleColumn(kPhases + 6 * header_->joints + 2 * header_->analogs + kWrenchSize * sensor + component);
+}
+
+const double* BlackBoxFile::wrenchCommand(const std::size_t sensor, const std::size_t component) const
+{
+  return wrench(header_->force_torques + sensor, component);
+}
+
+const uint8_t* BlackBoxFile::digitalValue(const std::size_t digital) const
+{
+  return reinterpret_cast<const uint8_t*>(
+           doubleColumn(doubleColumns(header_->joints, header_->analogs, header_->force_torques)))
+         + digital * samples();
+}
+
+const uint8_t* BlackBoxFile::digitalCommand(const std::size_t digital) const
+{
+  return digitalValue(header_->digitals + digital);
+}
+
+}  // namespace cnr_hardware_interface
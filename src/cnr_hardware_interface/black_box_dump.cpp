@@ -0,0 +1,182 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <cnr_hardware_interface/black_box.h>
+
+/**
+ * Print a black box file as CSV (one row per sample), or its summary with '-s'.
+ * Usage: cnr_hw_black_box_dump [-s] file.bbx
+ */
+int main(int argc, char** argv)
+{
+  bool summary = false;
+  std::string path;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "-s") == 0)
+    {
+      summary = true;
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+  if (path.empty())
+  {
+    std::cerr << "usage: " << argv[0] << " [-s] file.bbx" << std::endl;
+    return 1;
+  }
+
+  cnr_hardware_interface::BlackBoxFile file;
+  std::string what;
+  if (!file.open(path, &what))
+  {
+    std::cerr << what << std::endl;
+    return 1;
+  }
+
+  const cnr_hardware_interface::BlackBoxFileHeader& h = file.header();
+  if (summary)
+  {
+    std::cout << "samples:  " << h.samples << "\n"
+              << "trigger:  " << cnr_hardware_interface::to_string(static_cast<cnr_hardware_interface::StatusHw>(h.trigger_state))
+              << " at " << h.trigger_stamp_ns << " ns\n"
+              << "joints:   " << h.joints << "\n"
+              << "analogs:  " << h.analogs << "\n"
+              << "f/t:      " << h.force_torques << "\n"
+              << "digitals: " << h.digitals << std::endl;
+    if (h.samples > 0)
+    {
+      std::cout << "cycles:   " << file.cycle()[0] << " - " << file.cycle()[h.samples - 1] << "\n"
+                << "duration: " << (file.stamp()[h.samples - 1] - file.stamp()[0]) * 1e-9 << " s" << std::endl;
+    }
+    return 0;
+  }
+
+  std::cout << "cycle,stamp_ns,state";
+  for (const std::string& p : file.phaseNames())
+  {
+    std::cout << "," << p << " [s]";
+  }
+  for (const char* c : { "pos", "vel", "eff", "cmd_pos", "cmd_vel", "cmd_eff" })
+  {
+    for (const std::string& j : file.jointNames())
+    {
+      std::cout << "," << j << "/" << c;
+    }
+  }
+  for (const char* c : { "value", "cmd" })
+  {
+    for (const std::string& a : file.analogNames())
+    {
+      std::cout << "," << a << "/" << c;
+    }
+  }
+  for (const char* c : { "fx", "fy", "fz", "tx", "ty", "tz" })
+  {
+    for (const std::string& f : file.forceTorqueNames())
+    {
+      std::cout << "," << f << "/" << c;
+    }
+  }
+  for (const char* c : { "cmd_fx", "cmd_fy", "cmd_fz", "cmd_tx", "cmd_ty", "cmd_tz" })
+  {
+    for (const std::string& f : file.forceTorqueNames())
+    {
+      std::cout << "," << f << "/" << c;
+    }
+  }
+  for (const char* c : { "value", "cmd" })
+  {
+    for (const std::string& d : file.digitalNames())
+    {
+      std::cout << "," << d << "/" << c;
+    }
+  }
+  std::cout << "\n";
+
+  for (std::size_t k = 0; k < file.samples(); k++)
+  {
+    std::cout << file.cycle()[k] << "," << file.stamp()[k] << ","
+              << cnr_hardware_interface::to_string(static_cast<cnr_hardware_interface::StatusHw>(file.state()[k]));
+    for (std::size_t i = 0; i < h.phases; i++)
+    {
+      std::cout << "," << file.phase(i)[k];
+    }
+    for (auto column : { &cnr_hardware_interface::BlackBoxFile::position, &cnr_hardware_interface::BlackBoxFile::velocity,
+                         &cnr_hardware_interface::BlackBoxFile::effort, &cnr_hardware_interface::BlackBoxFile::commandPosition,
+                         &cnr_hardware_interface::BlackBoxFile::commandVelocity,
+                         &cnr_hardware_interface::BlackBoxFile::commandEffort })
+    {
+      for (std::size_t j = 0; j < h.joints; j++)
+      {
+        std::cout << "," << (file.*column)(j)[k];
+      }
+    }
+    for (std::size_t a = 0; a < h.analogs; a++)
+    {
+      std::cout << "," << file.analogValue(a)[k];
+    }
+    for (std::size_t a = 0; a < h.analogs; a++)
+    {
+      std::cout << "," << file.analogCommand(a)[k];
+    }
+    for (auto column : { &cnr_hardware_interface::BlackBoxFile::wrench,
+                         &cnr_hardware_interface::BlackBoxFile::wrenchCommand })
+    {
+      for (std::size_t c = 0; c < cnr_hardware_interface::HardwareBuffer::kWrenchSize; c++)
+      {
+        for (std::size_t f = 0; f < h.force_torques; f++)
+        {
+          std::cout << "," << (file.*column)(f, c)[k];
+        }
+      }
+    }
+    for (std::size_t d = 0; d < h.digitals; d++)
+    {
+      std::cout << "," << static_cast<int>(file.digitalValue(d)[k]);
+    }
+    for (std::size_t d = 0; d < h.digitals; d++)
+    {
+      std::cout << "," << static_cast<int>(file.digitalCommand(d)[k]);
+    }
+    std::cout << "\n";
+  }
+  return 0;
+}
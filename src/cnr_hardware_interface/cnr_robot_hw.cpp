@@ -38,12 +38,15 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <sstream>
+#include <cmath>
+#include <cstring>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <ros/ros.h>
-#include <rosparam_utilities/rosparam_utilities.h>
 #include <cnr_logger/cnr_logger.h>
 #include <cnr_hardware_interface/internal/vector_to_string.h>
+#include <cnr_hardware_interface/internal/rt_trace.h>
 #include <cnr_hardware_interface/cnr_robot_hw.h>
 
 #define GENERATE_ENUM_STRINGS  // Start string generation
@@ -54,51 +57,23 @@ namespace cnr_hardware_interface
 {
 
 inline
-void get_resource_names(ros::NodeHandle& nh, std::vector<std::string>& names)
+void get_resource_names(const cnr_hardware_interface::ParamCache& params, std::vector<std::string>& names)
 {
-  std::vector<std::string> alternative_keys =
+  static const std::vector<std::string> alternative_keys =
     { "controlled_resources", "controlled_resource",
       "controlled_joints", "controlled_joint",
       "joint_names", "joint_name",
       "joints", "joint",
-      "joint_resource/joint_names", "joint_resource/joint_name"
-      "joint_resource/controlled_joints", "joint_resource/controlled_joint"
+      "joint_resource/joint_names", "joint_resource/joint_name",
+      "joint_resource/controlled_joints", "joint_resource/controlled_joint",
       "joint_resource/controlled_resources", "joint_resource/controlled_resource"
       };
 
   names.clear();
   for(auto const & key : alternative_keys)
   {
-    bool ok = false;
-    std::string what;
-    try
-    {
-      ok = rosparam_utilities::get(nh.getNamespace() + "/" + key, names, what);
-    }
-    catch(const std::exception& e)
-    {
-      std::cerr <<"Exception in getting '"<< nh.getNamespace() << "/" << key << "': " << e.what() << '\n';
-      ok = false;
-    }
-    
-    if(!ok)
-    {
-      try 
-      {
-        std::string joint_name;
-        if(rosparam_utilities::get(nh.getNamespace() + "/" + key, joint_name, what))
-        {
-          names.push_back(joint_name);
-        }
-      }
-      catch(const std::exception& e)
-      {
-        std::cerr <<"Exception in getting '"<< nh.getNamespace() << "/" << key << "': " << e.what() << '\n';
-        ok = false;
-      }
-    }
-
-    if(ok)
+    // both a list of names and a single name are accepted
+    if(params.get(key, names))
     {
       break;
     }
@@ -107,8 +82,14 @@ void get_resource_names(ros::NodeHandle& nh, std::vector<std::string>& names)
 }
   
 RobotHW::RobotHW()
-  : m_set_status_param(nullptr), m_is_first_read(true), m_state(cnr_hardware_interface::CREATED),
-    m_state_prev(cnr_hardware_interface::CREATED), m_shutted_down(false)
+  : m_sampling_period(1e-3), m_set_status_param(nullptr), m_is_first_read(true), m_state(cnr_hardware_interface::CREATED),
+    m_state_prev(cnr_hardware_interface::CREATED), m_state_history(64), m_state_history_reported_drops(0),
+    m_shutted_down(false),
+    m_phase_timing(new cnr_hardware_interface::PhaseTimingStats(1000)), m_last_read_ns(0), m_rt_mode(false),
+    m_rt_log(256), m_rt_log_reported_drops(0), m_callbacks_in_rt(true), m_stop_background(true),
+    m_last_persist_latency(0.0), m_command_channel_enabled(false), m_command_limits_enabled(false), m_command_fault(false),
+    m_io_changes_enabled(false), m_read_cycles(0), m_sub_device_cycle(0), m_write_cycles(0),
+    m_controllers(m_active_controllers)
 {
   setState(cnr_hardware_interface::CREATED);
 }
@@ -118,6 +99,11 @@ RobotHW::~RobotHW()
   CNR_TRACE_START(m_logger);
   if(!m_shutted_down)
   {
+    if(m_background_thread.joinable() || m_callbacks_thread.joinable())
+    {
+      CNR_WARN(m_logger, "RobotHW '" << m_robot_name << "' destroyed without shutdown(): the derived class must call it "
+                         "in its destructor, since its callbacks could run while it was being destroyed");
+    }
     if(!shutdown())
     {
       setState(cnr_hardware_interface::ERROR);
@@ -127,6 +113,7 @@ RobotHW::~RobotHW()
       setState(cnr_hardware_interface::SHUTDOWN);
     }
   }
+  stopBackgroundThread();
   CNR_TRACE(m_logger, "[  DONE] ");
 }
 
@@ -140,61 +127,166 @@ bool RobotHW::init(ros::NodeHandle& root_nh, ros::NodeHandle &robothw_nh)
   {
     std::cerr << __PRETTY_FUNCTION__ << ":" << "Error in creating the logger!" << std::endl;
     std::cerr <<  "what:" << what << std::endl;
+    setState(cnr_hardware_interface::ERROR);  // initAsync() has already moved the state to INITIALIZING
     return false;
   }
   
   CNR_TRACE_START(m_logger);
+  setState(cnr_hardware_interface::INITIALIZING);
   if(enterInit(root_nh, robothw_nh) && doInit() && exitInit())
   {
+    // the background thread serves the services from now on, while the declared parameters cannot change
+    m_parameters.seal();
+    ros::NodeHandle params_nh(robothw_nh);
+    params_nh.setCallbackQueue(&m_params_queue);
+    m_set_param = params_nh.advertiseService("writeParams", &cnr_hardware_interface::RobotHW::setParamServer, this);
+    m_get_param = params_nh.advertiseService("readParams", &cnr_hardware_interface::RobotHW::getParamServer, this);
     CNR_RETURN_TRUE(m_logger, "RobotHW '" + m_robot_name + "' Initialization OK");
   }
-  
+
+  setState(cnr_hardware_interface::ERROR);
   CNR_RETURN_FALSE(m_logger,  "RobotHW '" + m_robot_name + "' Initialization Failed");
 }
 
+std::future<bool> RobotHW::initAsync(const ros::NodeHandle& root_nh, const ros::NodeHandle& robot_hw_nh)
+{
+  setState(cnr_hardware_interface::INITIALIZING);
+  return std::async(std::launch::async, [this, root = root_nh, robothw = robot_hw_nh]() mutable
+  {
+    return init(root, robothw);
+  });
+}
+
 void RobotHW::read(const ros::Time& time, const ros::Duration& period)
 {
-  CNR_TRACE_START_THROTTLE_DEFAULT(m_logger);
+  CNR_HW_RT_ALLOC_GUARD(m_rt_alloc_stats);
+  cnr_hardware_interface::ScopedPhaseRecord read_time(*m_phase_timing, cnr_hardware_interface::RTPhase::READ);
+  if(m_last_read_ns > 0)
+  {
+    m_phase_timing->record(cnr_hardware_interface::RTPhase::CYCLE, read_time.start() - m_last_read_ns);
+  }
+  m_last_read_ns = read_time.start();
+
+  CNR_HW_RT_TRACE_START(m_logger, m_rt_mode);
 
   if(m_is_first_read)
   {
     setState(cnr_hardware_interface::RUNNING);
     m_is_first_read = false;
-    if(m_set_status_param)
-    {
-      m_set_status_param("first_configuration");
-    }
+    m_status_snapshots.request(cnr_hardware_interface::StatusSnapshot::FIRST_CONFIGURATION);
   }
 
-  m_robot_hw_queue.callAvailable();
+  // the batches staged by writeParams are applied at the cycle boundary
+  m_parameters.commit();
+  m_sub_device_cycle  = m_read_cycles++;
+  m_sub_device_time[static_cast<std::size_t>(cnr_hardware_interface::SubDeviceScheduler::Stage::READ)]   = time;
+  m_sub_device_period[static_cast<std::size_t>(cnr_hardware_interface::SubDeviceScheduler::Stage::READ)] = period;
+
+  uint64_t t_do_read = cnr_hardware_interface::monotonicNs();
+  if(callbacksInRT())
+  {
+    const uint64_t t_callbacks = t_do_read;
+    m_robot_hw_queue.callAvailable();
+    t_do_read = cnr_hardware_interface::monotonicNs();
+    m_phase_timing->record(cnr_hardware_interface::RTPhase::READ_CALLBACKS, t_do_read - t_callbacks);
+  }
+
+  bool ok = doRead(time, period);
+  m_phase_timing->record(cnr_hardware_interface::RTPhase::DO_READ, cnr_hardware_interface::monotonicNs() - t_do_read);
+  if(!ok)
+  {
+    setState(cnr_hardware_interface::ERROR);
+    m_rt_log.push(cnr_hardware_interface::RTLogLevel::ERROR, "Error in reading...");
+    return;
+  }
 
-  if(!doRead(time, period))
+  if(m_sub_devices.dispatch(cnr_hardware_interface::SubDeviceScheduler::Stage::READ, m_sub_device_cycle))
   {
     setState(cnr_hardware_interface::ERROR);
-    CNR_RETURN_NOTOK_THROTTLE(m_logger, void(), 5.0);
+    m_rt_log.push(cnr_hardware_interface::RTLogLevel::ERROR, "Error in reading a sub-device...");
+    return;
   }
 
-  CNR_RETURN_OK_THROTTLE_DEFAULT(m_logger, void());
+  for(const std::unique_ptr<WrenchChannel>& ft : m_wrench_channels)
+  {
+    ft->processor.update(ft->force, ft->torque);
+    const bool saturated = ft->processor.saturated().any();
+    if(saturated && !ft->saturated)
+    {
+      m_rt_log.push(cnr_hardware_interface::RTLogLevel::WARN, "Force-torque sensor saturated");
+    }
+    ft->saturated = saturated;
+  }
+
+  if(m_io_changes_enabled)
+  {
+    m_io_changes.update(m_buffer);
+  }
+  CNR_HW_RT_RETURN_OK(m_logger, m_rt_mode, void());
 }
 
 void RobotHW::write(const ros::Time& time, const ros::Duration& period)
 {
-  CNR_TRACE_START_THROTTLE_DEFAULT(m_logger);
-  if(!doWrite(time, period))
+  CNR_HW_RT_ALLOC_GUARD(m_rt_alloc_stats);
+  cnr_hardware_interface::ScopedPhaseRecord write_time(*m_phase_timing, cnr_hardware_interface::RTPhase::WRITE);
+  CNR_HW_RT_TRACE_START(m_logger, m_rt_mode);
+
+  if(m_command_limits_enabled)
+  {
+    m_command_limits.apply(m_buffer);
+    if(m_command_limits.invalidJoint() >= 0)
+    {
+      setState(cnr_hardware_interface::CTRL_ERROR);
+      if(!m_command_fault.exchange(true, std::memory_order_acq_rel))
+      {
+        m_rt_log.push(cnr_hardware_interface::RTLogLevel::ERROR, "Command limits: non-finite command of a joint, held");
+      }
+    }
+    if(!m_command_limits.check(m_buffer))
+    {
+      setState(cnr_hardware_interface::CTRL_ERROR);
+      m_command_fault.store(true, std::memory_order_release);
+      m_rt_log.push(cnr_hardware_interface::RTLogLevel::ERROR, "Command watchdog: stale command of a joint, held");
+    }
+  }
+
+  if(m_command_channel_enabled)
+  {
+    m_command_channel.publish(m_buffer);
+  }
+
+  const uint64_t t_do_write = cnr_hardware_interface::monotonicNs();
+  bool ok = doWrite(time, period);
+  m_phase_timing->record(cnr_hardware_interface::RTPhase::DO_WRITE, cnr_hardware_interface::monotonicNs() - t_do_write);
+  if(!ok)
   {
     setState(cnr_hardware_interface::ERROR);
-    CNR_RETURN_NOTOK_THROTTLE(m_logger, void(), 5.0, "Error in writing...");  
+    m_rt_log.push(cnr_hardware_interface::RTLogLevel::ERROR, "Error in writing...");
+    return;
+  }
+
+  m_sub_device_time[static_cast<std::size_t>(cnr_hardware_interface::SubDeviceScheduler::Stage::WRITE)]   = time;
+  m_sub_device_period[static_cast<std::size_t>(cnr_hardware_interface::SubDeviceScheduler::Stage::WRITE)] = period;
+  if(m_sub_devices.dispatch(cnr_hardware_interface::SubDeviceScheduler::Stage::WRITE, m_sub_device_cycle))
+  {
+    setState(cnr_hardware_interface::ERROR);
+    m_rt_log.push(cnr_hardware_interface::RTLogLevel::ERROR, "Error in writing a sub-device...");
+    return;
   }
   
-  if(m_state_prev != getState())
+  if(m_state_prev.load(std::memory_order_acquire) != getState())
   {
-     if(m_set_status_param)
-     {
-       m_set_status_param("last_valid_configuration");
-     }
+     m_status_snapshots.request(cnr_hardware_interface::StatusSnapshot::LAST_VALID_CONFIGURATION);
      setState(getState()); // re-setting the state, I also change the m_state_prev
   }
-  CNR_RETURN_OK_THROTTLE_DEFAULT(m_logger, void());
+
+  m_write_cycles++;
+  if(m_shm_state.isOpen())
+  {
+    m_shm_state.publish(m_write_cycles, getState(), *m_phase_timing, m_buffer);
+  }
+  m_black_box.record(m_write_cycles, getState(), *m_phase_timing, m_buffer);
+  CNR_HW_RT_RETURN_OK(m_logger, m_rt_mode, void());
 }
 
 // THE FUNCTION IS CALLED JUST BEFORE PREPARE SWITCH.
@@ -207,61 +299,48 @@ bool RobotHW::checkForConflict(const std::list< hardware_interface::ControllerIn
   if(::hardware_interface::RobotHW::checkForConflict(info))
   {
     setState(cnr_hardware_interface::ERROR);
-    std::string result = cnr_logger::RED() + "[ERROR] Base Check failed" + cnr_logger::RESET();
-    CNR_TRACE(m_logger, result << __FUNCTION__);
+    CNR_TRACE(m_logger, cnr_logger::RED() << "[ERROR] Base Check failed" << cnr_logger::RESET() << __FUNCTION__);
     return true;
   }
 
   // Each controller can use more than a hardware_interface for a single joint (e.g.: position, velocity, effort)
   // One controller can control more than one joint. A joint can be used only by a controller.
-  std::vector<bool> global_resource_used(m_resource_names.size());
-  std::fill(global_resource_used.begin(), global_resource_used.end(), false);
-
-  for (hardware_interface::ControllerInfo controller : info)
+  // The resources are looked up in the index built with the resource names, and the claims are tracked in
+  // preallocated bitsets, so that the check is linear in the number of claimed resources.
+  m_claimed_resources.clear();
+  for (const hardware_interface::ControllerInfo& controller : info)
   {
-    std::vector<bool> single_controller_resource_used(m_resource_names.size());
-    std::fill(single_controller_resource_used.begin(), single_controller_resource_used.end(), false);
-
-    for (hardware_interface::InterfaceResources res : controller.claimed_resources)
+    m_controller_resources.clear();
+    for (const hardware_interface::InterfaceResources& res : controller.claimed_resources)
     {
-      for (std::string name : res.resources)
+      for (const std::string& name : res.resources)
       {
-        for (unsigned int iJ = 0; iJ < m_resource_names.size(); iJ++)
+        const int iJ = m_resource_index.find(name);
+        if(iJ < 0)
+        {
+          continue;
+        }
+        if(m_claimed_resources.test(static_cast<std::size_t>(iJ)))   // if already used by another
         {
-          if(!name.compare(m_resource_names.at(iJ)))
-          {
-            if(global_resource_used.at(iJ))   // if already used by another
-            {
-              CNR_FATAL(m_logger, "Joint " + name + "%s is already used by another controller" ); 
-              setState(cnr_hardware_interface::CTRL_ERROR);
-              std::string result = cnr_logger::RED() + "[ERROR] " + cnr_logger::RESET();
-              CNR_TRACE(m_logger, result << __FUNCTION__);
-              return true;
-            }
-            else
-            {
-              single_controller_resource_used.at(iJ) = true;
-            }
-          }
+          CNR_FATAL(m_logger, "Joint " << name << " is already used by another controller");
+          setState(cnr_hardware_interface::CTRL_ERROR);
+          CNR_TRACE(m_logger, cnr_logger::RED() << "[ERROR] " << cnr_logger::RESET() << __FUNCTION__);
+          return true;
         }
+        m_controller_resources.set(static_cast<std::size_t>(iJ));
       }
     }
-    for (unsigned int iJ = 0; iJ < m_resource_names.size() ; iJ++)
-    {
-      global_resource_used.at(iJ) = global_resource_used.at(iJ) || single_controller_resource_used.at(iJ);
-    }
+    m_claimed_resources |= m_controller_resources;
   }
 
   if(doCheckForConflict(info))
   {
     setState(cnr_hardware_interface::ERROR);
-    std::string result = cnr_logger::RED() + "[ERROR] " + cnr_logger::RESET();
-    CNR_TRACE(m_logger, result << __FUNCTION__);
+    CNR_TRACE(m_logger, cnr_logger::RED() << "[ERROR] " << cnr_logger::RESET() << __FUNCTION__);
     return true;
   }
 
-  std::string result = cnr_logger::GREEN() + "[  DONE] " + cnr_logger::RESET();
-  CNR_TRACE(m_logger, result << __FUNCTION__);
+  CNR_TRACE(m_logger, cnr_logger::GREEN() << "[  DONE] " << cnr_logger::RESET() << __FUNCTION__);
   return false;
 }
 
@@ -277,46 +356,54 @@ bool RobotHW::prepareSwitch(const std::list< hardware_interface::ControllerInfo
   {
     CNR_RETURN_FALSE(m_logger, "The controller switch is not possible, since the RobotHw is in ERROR state.");
   }
+  if(getState()==cnr_hardware_interface::INITIALIZING)
+  {
+    CNR_RETURN_FALSE(m_logger, "The controller switch is not possible, since the RobotHw is still initializing.");
+  }
+  if(m_controllers.pendingSwitches() > 0)
+  {
+    CNR_RETURN_FALSE(m_logger, "The controller switch is not possible, since the previous switch is still ongoing.");
+  }
 
   //====== CHECK COHERENCE WITH ACTUAL STORED STATE
   std::stringstream report;
   for (const hardware_interface::ControllerInfo& ctrl : stop_list)
   {
-    std::list<hardware_interface::ControllerInfo>::iterator stopped_controller =
-      std::find_if(m_active_controllers.begin(), m_active_controllers.end(),
-                   [&ctrl](hardware_interface::ControllerInfo & it) { return (it.name == ctrl.name); });  //NOLINT
-
-    if(m_active_controllers.end() == stopped_controller)
+    if(!m_controllers.isActive(ctrl.name))
     {
       addDiagnosticsMessage("ERROR", "controller '" + ctrl.name + "' is not active, so I cannot stop it",
                               { {"Transition", "switching"} }, &report);  //NOLINT
       setState(cnr_hardware_interface::CTRL_ERROR);
       CNR_RETURN_FALSE(m_logger, report.str());
     }
-    m_active_controllers.erase(stopped_controller);
   }
-  for (const hardware_interface::ControllerInfo& ctrl : start_list)
+  if(start_list.size() + stop_list.size() > m_controllers.maxSwitching())
   {
-    std::list<hardware_interface::ControllerInfo>::iterator to_start_controller =
-      std::find_if(m_active_controllers.begin(), m_active_controllers.end(),
-                   [&ctrl](hardware_interface::ControllerInfo & it) { return (it.name == ctrl.name); });  //NOLINT
-    if(m_active_controllers.end() != to_start_controller)
-    {
-      CNR_WARN(m_logger, "controller " << ctrl.name << "is already active, so I cannot start it");
-    }
-    else
-    {
-      m_active_controllers.push_back(ctrl);
-    }
+    CNR_RETURN_FALSE(m_logger, "The controller switch is not possible, since it involves more than "
+                                 + std::to_string(m_controllers.maxSwitching()) + " controllers.");
   }
   //====== CHECK COHERENCE WITH ACTUAL STORED STATE
 
 
+  // the active controllers are updated only if the derived class accepts the switch
   if(!doPrepareSwitch(start_list, stop_list))
   {
     CNR_RETURN_FALSE(m_logger);
   }
 
+  for (const hardware_interface::ControllerInfo& ctrl : stop_list)
+  {
+    m_controllers.deactivate(ctrl.name);
+  }
+  for (const hardware_interface::ControllerInfo& ctrl : start_list)
+  {
+    if(!m_controllers.activate(ctrl))
+    {
+      CNR_WARN(m_logger, "controller " << ctrl.name << "is already active, so I cannot start it");
+    }
+  }
+  m_controllers.beginSwitch(start_list, stop_list);
+
   setState(cnr_hardware_interface::READY_TO_SWITCH);
 
   m_is_first_read = false;
@@ -327,6 +414,8 @@ bool RobotHW::prepareSwitch(const std::list< hardware_interface::ControllerInfo
 void RobotHW::doSwitch(const std::list<hardware_interface::ControllerInfo>& start_list,
                        const std::list<hardware_interface::ControllerInfo>& stop_list)
 {
+  CNR_HW_RT_ALLOC_GUARD(m_rt_alloc_stats);
+  cnr_hardware_interface::ScopedPhaseRecord switch_time(*m_phase_timing, cnr_hardware_interface::RTPhase::SWITCH);
   CNR_TRACE_START(m_logger,"************** DO SWITCH OF CONTROLLERS (IN RT UPDATE) *****************************");
   CNR_DEBUG(m_logger, "RobotHW '" << m_robothw_nh.getNamespace()
                         << "' Status " <<  cnr_hardware_interface::to_string(getState()));
@@ -339,12 +428,19 @@ void RobotHW::doSwitch(const std::list<hardware_interface::ControllerInfo>& star
   }
 
   setState(cnr_hardware_interface::DOING_SWITCH);
-  if(!doDoSwitch(start_list, stop_list))
+  m_command_limits.disarm();  // the joints are watched again since the first command of the new controllers
+  const uint64_t t_do_switch = cnr_hardware_interface::monotonicNs();
+  bool ok = doDoSwitch(start_list, stop_list);
+  m_phase_timing->record(cnr_hardware_interface::RTPhase::DO_SWITCH, cnr_hardware_interface::monotonicNs() - t_do_switch);
+  if(!ok)
   {
+    m_controllers.endSwitch(hardware_interface::RobotHW::SwitchState::ERROR);
     setState(cnr_hardware_interface::ERROR);
     CNR_RETURN_NOTOK(m_logger, void());
   }
-  setState(cnr_hardware_interface::SWITCH_DONE);
+  m_controllers.endSwitch(hardware_interface::RobotHW::SwitchState::DONE);
+  setState(m_controllers.pendingSwitches() > 0 ? cnr_hardware_interface::DOING_SWITCH
+                                               : cnr_hardware_interface::SWITCH_DONE);
 
   CNR_TRACE(m_logger, "************** DO SWITCH OF CONTROLLERS (IN RT UPDATE)- END ************************");
   CNR_RETURN_OK(m_logger, void());
@@ -359,32 +455,194 @@ hardware_interface::RobotHW::SwitchState RobotHW::switchResult() const
            hardware_interface::RobotHW::SwitchState::ERROR;
 }
 
-// TODO manage each controller
+// The controllers involved in the last switch are tracked one by one, the others are not affected by the switch
 hardware_interface::RobotHW::SwitchState RobotHW::switchResult(const hardware_interface::ControllerInfo& controller) const
 {
-    return getState() == cnr_hardware_interface::ERROR ? hardware_interface::RobotHW::SwitchState::ERROR : 
-           getState() == cnr_hardware_interface::DOING_SWITCH ? hardware_interface::RobotHW::SwitchState::ONGOING : 
-           getState() == cnr_hardware_interface::RUNNING ? hardware_interface::RobotHW::SwitchState::DONE : 
-           hardware_interface::RobotHW::SwitchState::ERROR;
+  if(getState() == cnr_hardware_interface::ERROR
+  || getState() == cnr_hardware_interface::CTRL_ERROR
+  || getState() == cnr_hardware_interface::SRV_ERROR)
+  {
+    return hardware_interface::RobotHW::SwitchState::ERROR;
+  }
+
+  hardware_interface::RobotHW::SwitchState state;
+  return m_controllers.switchState(controller.name, state) ? state : hardware_interface::RobotHW::SwitchState::DONE;
+}
+
+
+
+void RobotHW::enableCommandChannel()
+{
+  m_command_channel.resize(m_buffer);
+  m_command_channel_enabled = true;
+}
+
+void RobotHW::enableIOChangeDetection(const double analog_deadband)
+{
+  m_io_changes.resize(m_buffer, analog_deadband);
+  m_io_change_interface.registerHandle(hardware_interface::IOChangeHandle("io_changes", &m_io_changes, &m_buffer));
+  registerInterface(&m_io_change_interface);
+  m_io_changes_enabled = true;
+}
+
+bool RobotHW::registerSubDevice(const std::string& name, const SubDeviceCallback& read, const SubDeviceCallback& write,
+                                const unsigned int divisor, const unsigned int phase, const double budget)
+{
+  int d = static_cast<int>(divisor);
+  int p = static_cast<int>(phase);
+  m_params.get("sub_devices/" + name + "/divisor", d);
+  m_params.get("sub_devices/" + name + "/phase", p);
+  if(d <= 0 || p < 0 || p >= d)
+  {
+    CNR_ERROR(m_logger, "Sub-device '" << name << "': the divisor must be positive and the phase in [0, divisor)");
+    return false;
+  }
+
+  // each stage gets the time and the period of its own call, read() or write()
+  typedef cnr_hardware_interface::SubDeviceScheduler::Stage Stage;
+  auto wrap = [this, d](const SubDeviceCallback& cb, const Stage stage)
+    -> cnr_hardware_interface::SubDeviceScheduler::Callback
+  {
+    if(!cb)
+    {
+      return cnr_hardware_interface::SubDeviceScheduler::Callback();
+    }
+    const std::size_t s = static_cast<std::size_t>(stage);
+    return [this, d, cb, s]() { return cb(m_sub_device_time[s], m_sub_device_period[s] * static_cast<double>(d)); };
+  };
+  const double budget_s = budget > 0.0 ? budget : m_sampling_period;
+  if(!m_sub_devices.add(name, wrap(read, Stage::READ), wrap(write, Stage::WRITE), static_cast<uint32_t>(d),
+                        static_cast<uint32_t>(p), static_cast<uint64_t>(budget_s * 1e9)))
+  {
+    CNR_ERROR(m_logger, "Sub-device '" << name << "' already registered");
+    return false;
+  }
+  CNR_DEBUG(m_logger, "Sub-device '" << name << "' every " << d << " cycles, phase " << p);
+  return true;
+}
+
+bool RobotHW::addWrenchProcessing(hardware_interface::ForceTorqueStateInterface& iface, const std::string& sensor)
+{
+  const std::string ns = "ft_processing/" + sensor + "/";
+  cnr_hardware_interface::WrenchProcessingConfig config;
+  m_params.get(ns + "cutoff_frequency", config.cutoff_frequency);
+  m_params.get(ns + "force_limit", config.force_limit);
+  m_params.get(ns + "torque_limit", config.torque_limit);
+  m_params.get(ns + "frame_id", config.frame_id);
+  for(auto& v : { std::make_pair(std::string("translation"), &config.translation),
+                  std::make_pair(std::string("rotation_rpy"), &config.rotation_rpy) })
+  {
+    std::vector<double> values;
+    if(m_params.get(ns + v.first, values))
+    {
+      if(values.size() != 3)
+      {
+        CNR_ERROR(m_logger, "'" << ns + v.first << "' must have 3 elements");
+        return false;
+      }
+      std::copy(values.begin(), values.end(), v.second->begin());
+    }
+  }
+  return addWrenchProcessing(iface, sensor, config);
+}
+
+bool RobotHW::addWrenchProcessing(hardware_interface::ForceTorqueStateInterface& iface, const std::string& sensor,
+                                  const cnr_hardware_interface::WrenchProcessingConfig& config)
+{
+  const std::vector<std::string> names = iface.getNames();
+  if(std::find(names.begin(), names.end(), sensor) == names.end())
+  {
+    CNR_ERROR(m_logger, "The force-torque sensor '" << sensor << "' is not registered in the interface");
+    return false;
+  }
+  const hardware_interface::ForceTorqueStateHandle raw = iface.getHandle(sensor);
+  if(!raw.getForce() || !raw.getTorque())
+  {
+    CNR_ERROR(m_logger, "The force-torque sensor '" << sensor << "' has no force/torque storage");
+    return false;
+  }
+
+  std::unique_ptr<WrenchChannel> ft(new WrenchChannel());
+  ft->sensor    = sensor;
+  ft->force     = raw.getForce();
+  ft->torque    = raw.getTorque();
+  ft->saturated = false;
+  ft->processor.configure(config, m_sampling_period);
+  const std::string frame_id = config.frame_id.empty() ? raw.getFrameId() : config.frame_id;
+  iface.registerHandle(hardware_interface::ForceTorqueStateHandle(sensor + "/filtered", frame_id,
+                                                                  ft->processor.force(), ft->processor.torque()));
+  m_wrench_channels.push_back(std::move(ft));
+  CNR_DEBUG(m_logger, "Force-torque processing of '" << sensor << "' (cutoff " << config.cutoff_frequency
+            << " Hz), published as '" << sensor << "/filtered' in the frame '" << frame_id << "'");
+  return true;
 }
 
+bool RobotHW::tareWrench(const std::string& sensor)
+{
+  for(const std::unique_ptr<WrenchChannel>& ft : m_wrench_channels)
+  {
+    if(ft->sensor == sensor)
+    {
+      ft->processor.tare();
+      return true;
+    }
+  }
+  return false;
+}
 
+bool RobotHW::resetCommandFault()
+{
+  if(getState() != cnr_hardware_interface::CTRL_ERROR || !m_command_fault.load(std::memory_order_acquire)
+     || m_command_limits.heldJoints() > 0)
+  {
+    return false;
+  }
+  m_command_fault.store(false, std::memory_order_release);
+  return setState(cnr_hardware_interface::RUNNING);
+}
+
+bool RobotHW::deferControllerSwitch(const std::string& controller)
+{
+  return m_controllers.deferSwitch(controller);
+}
+
+bool RobotHW::completeControllerSwitch(const std::string& controller, const bool ok)
+{
+  if(!m_controllers.completeSwitch(controller, ok ? hardware_interface::RobotHW::SwitchState::DONE
+                                                  : hardware_interface::RobotHW::SwitchState::ERROR))
+  {
+    return false;
+  }
+  if(!ok)
+  {
+    setState(cnr_hardware_interface::CTRL_ERROR);
+    m_rt_log.push(cnr_hardware_interface::RTLogLevel::ERROR, "Deferred controller switch failed");
+  }
+  else if(m_controllers.pendingSwitches() == 0 && getState() == cnr_hardware_interface::DOING_SWITCH)
+  {
+    setState(cnr_hardware_interface::SWITCH_DONE);
+  }
+  return true;
+}
 
 bool RobotHW::shutdown()
 {
   CNR_TRACE_START(m_logger, ">>>> RobotHW Shutdown (" + m_robot_name + ")");
+  // no callback, nor param service, runs anymore on the derived class, that may be under destruction
+  m_set_param.shutdown();
+  m_get_param.shutdown();
+  stopBackgroundThread();
   if(!doShutdown())
   {
     setState(cnr_hardware_interface::ERROR);
     CNR_RETURN_FALSE(m_logger, "<<<< Robot Shutdown Failure (" + m_robot_name + ")");
   }
 
-  if(m_set_status_param)
-  {
-    m_set_status_param("shutdown_configuration");
-  }
+  m_status_snapshots.request(cnr_hardware_interface::StatusSnapshot::SHUTDOWN_CONFIGURATION);
+  flushStatusSnapshots();
   m_shutted_down =  true;
   setState(cnr_hardware_interface::SHUTDOWN);
+  flushStateTransitions();
   CNR_RETURN_TRUE(m_logger, "<<<< Robot Shutdown (" + m_robot_name + ")");
 }
 
@@ -398,14 +656,42 @@ bool RobotHW::enterInit(ros::NodeHandle& root_nh, ros::NodeHandle& robothw_nh)
   m_root_nh     = root_nh;
   m_stop_thread = false;
   m_robot_name  = extractRobotName(m_robothw_nh.getNamespace());
-  m_set_param   = m_robothw_nh.advertiseService("writeParams", &cnr_hardware_interface::RobotHW::setParamServer, this);
-  m_get_param   = m_robothw_nh.advertiseService("readParams", &cnr_hardware_interface::RobotHW::getParamServer, this);
+
+  // 'writeParams' and 'readParams' are advertised again at the end of init(), when no parameter can be declared
+  m_set_param.shutdown();
+  m_get_param.shutdown();
+  m_parameters.unseal();
+
+  // the stages configured by the previous doInit() are dropped, since they point into the columns of m_buffer that
+  // the new doInit() reallocates
+  m_sub_devices.clear();
+  m_wrench_channels.clear();
+  m_io_changes_enabled      = false;
+  m_command_channel_enabled = false;
+  m_command_limits_enabled  = false;
+  m_command_fault.store(false, std::memory_order_release);
 
   m_robot_hw_queue.callAvailable();
 
+  startBackgroundThread();
+
+  // a single round-trip to the master: all the following parameters (and the ones of doInit) are read from m_params
+  if(!m_params.load(m_robothw_nh))
+  {
+    CNR_WARN(m_logger, "No parameters in the namespace '" << m_robothw_nh.getNamespace() << "'");
+  }
+
+  bool callbacks_thread = false;
+  if(m_params.get("callbacks_thread", callbacks_thread) && callbacks_thread && !m_callbacks_thread.joinable())
+  {
+    m_callbacks_in_rt = false;
+    m_callbacks_thread = std::thread(&RobotHW::callbacksLoop, this);
+  }
+
   realtime_utilities::DiagnosticsInterface::init(m_robot_name, "RobotHW", m_robot_name );
   
-  get_resource_names(m_robothw_nh,m_resource_names);
+  get_resource_names(m_params, m_resource_names);
+  indexResourceNames();
   if(m_resource_names.size()==0)
   {
     setState(cnr_hardware_interface::ERROR);
@@ -414,12 +700,36 @@ bool RobotHW::enterInit(ros::NodeHandle& root_nh, ros::NodeHandle& robothw_nh)
   }
   CNR_DEBUG(m_logger, "Resources: " << cnr_hardware_interface::to_string(m_resource_names));
 
-  std::string what;
-  if(!rosparam_utilities::get(m_robothw_nh.getNamespace() + "/sampling_period", m_sampling_period, what))
+  if(!m_params.get("sampling_period", m_sampling_period))
   {
     m_sampling_period = 1e-3;
     CNR_WARN(m_logger, "Sampling period not found");
   }
+
+  if(!m_params.get("rt_mode", m_rt_mode))
+  {
+    m_rt_mode = false;
+  }
+
+  int timing_window = 0;
+  if(m_params.get("timing_window", timing_window) && timing_window > 0)
+  {
+    m_phase_timing.reset(new cnr_hardware_interface::PhaseTimingStats(static_cast<std::size_t>(timing_window)));
+  }
+
+  bool rt_alloc_abort = false;
+  if(m_params.get("rt_alloc_abort", rt_alloc_abort) && rt_alloc_abort)
+  {
+    if(cnr_hardware_interface::rtAllocTrackingEnabled())
+    {
+      CNR_WARN(m_logger, "Any heap allocation in read(), write() and doSwitch() will abort the process");
+    }
+    else
+    {
+      CNR_WARN(m_logger, "'rt_alloc_abort' ignored, since the library has been built without CNR_HW_RT_ALLOC_CHECK");
+    }
+  }
+  m_rt_alloc_stats.setAbortOnAllocation(rt_alloc_abort);
   CNR_RETURN_TRUE(m_logger);
 }
 
@@ -433,6 +743,75 @@ bool RobotHW::exitInit()
     CNR_FATAL(m_logger, "Reources names not set! Remeber to assign them in the doInit function. ");
   }
 
+  std::string shm_state_name;
+  if(ret && m_params.get("shm_state_name", shm_state_name) && !shm_state_name.empty())
+  {
+    std::string what;
+    if(m_buffer.jointNumber() == 0)
+    {
+      CNR_WARN(m_logger, "'shm_state_name' ignored, since the joints are not stored in m_buffer");
+    }
+    else if(!m_shm_state.create(shm_state_name, m_buffer, &what))
+    {
+      CNR_WARN(m_logger, "The state will not be published in the shared memory: " << what);
+    }
+    else
+    {
+      CNR_INFO(m_logger, "The state is published in the shared memory '" << shm_state_name << "'");
+    }
+  }
+
+  if(ret && m_buffer.jointNumber() > 0)
+  {
+    m_command_limits.resize(m_buffer.jointNumber());
+    bool any_limit = false;
+    for(std::size_t i = 0; i < m_buffer.jointNumber(); i++)
+    {
+      const std::string ns = "joint_limits/" + m_buffer.jointNames().at(i) + "/";
+      bool has_limits = false;
+      double lower = 0.0, upper = 0.0;
+      if(m_params.get(ns + "has_position_limits", has_limits) && has_limits
+         && m_params.get(ns + "min_position", lower) && m_params.get(ns + "max_position", upper))
+      {
+        m_command_limits.setPositionLimits(i, lower, upper);
+        any_limit = true;
+      }
+      if(m_params.get(ns + "has_velocity_limits", has_limits) && has_limits && m_params.get(ns + "max_velocity", upper))
+      {
+        m_command_limits.setVelocityLimit(i, upper);
+        any_limit = true;
+      }
+      if(m_params.get(ns + "has_effort_limits", has_limits) && has_limits && m_params.get(ns + "max_effort", upper))
+      {
+        m_command_limits.setEffortLimit(i, upper);
+        any_limit = true;
+      }
+    }
+    int watchdog_cycles = 0;
+    m_params.get("command_watchdog_cycles", watchdog_cycles);
+    m_command_limits.setWatchdog(watchdog_cycles > 0 ? static_cast<uint32_t>(watchdog_cycles) : 0);
+    // the non-finite commands are always checked
+    m_command_limits_enabled = true;
+    m_command_fault.store(false, std::memory_order_release);
+    CNR_INFO(m_logger, "Command limits " << (any_limit ? "enabled" : "disabled") << ", command watchdog of "
+              << m_command_limits.watchdogCycles() << " cycles");
+  }
+
+  double black_box_duration = 0.0;
+  if(ret && m_params.get("black_box_duration", black_box_duration) && black_box_duration > 0.0)
+  {
+    m_params.get("black_box_directory", m_black_box_directory, std::string("/tmp"));
+    if(m_buffer.jointNumber() == 0)
+    {
+      CNR_WARN(m_logger, "'black_box_duration' ignored, since the joints are not stored in m_buffer");
+    }
+    else
+    {
+      m_black_box.resize(m_buffer, static_cast<std::size_t>(std::ceil(black_box_duration / m_sampling_period)));
+      CNR_INFO(m_logger, "Black box of " << m_black_box.capacity() << " samples, dumped in '" << m_black_box_directory << "'");
+    }
+  }
+
   setState(ret ? cnr_hardware_interface::INITIALIZED : cnr_hardware_interface::ERROR);
   CNR_RETURN_BOOL(m_logger, ret);
 }
@@ -442,22 +821,362 @@ bool RobotHW::exitInit()
 
 bool RobotHW::getParamServer(configuration_msgs::GetConfigRequest& req, configuration_msgs::GetConfigResponse& res)
 {
+  const cnr_hardware_interface::ParameterValues staged = m_parameters.staged();
+  XmlRpc::XmlRpcValue tuning;
+  for(std::size_t i = 0; i < m_parameters.size(); i++)
+  {
+    tuning[m_parameters.names().at(i)] = staged.values.at(i);
+  }
+  if(m_parameters.size() > 0)
+  {
+    m_robothw_nh.setParam("tuning", tuning);
+  }
   return true;
 }
 
 bool RobotHW::setParamServer(configuration_msgs::SetConfigRequest& req, configuration_msgs::SetConfigResponse& res)
 {
+  XmlRpc::XmlRpcValue tuning;
+  if(!m_robothw_nh.getParam("tuning", tuning) || tuning.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+  {
+    CNR_ERROR(m_logger, "writeParams: the struct '" << m_robothw_nh.getNamespace() << "/tuning' is missing");
+    return false;
+  }
+
+  std::vector<std::pair<std::string, double>> batch;
+  for(auto it = tuning.begin(); it != tuning.end(); ++it)
+  {
+    const XmlRpc::XmlRpcValue::Type type = it->second.getType();
+    if(type == XmlRpc::XmlRpcValue::TypeDouble)
+    {
+      batch.push_back(std::make_pair(it->first, static_cast<double>(it->second)));
+    }
+    else if(type == XmlRpc::XmlRpcValue::TypeInt)
+    {
+      batch.push_back(std::make_pair(it->first, static_cast<double>(static_cast<int>(it->second))));
+    }
+    else
+    {
+      CNR_ERROR(m_logger, "writeParams: '" << it->first << "' is not a number, the batch is refused");
+      return false;
+    }
+  }
+
+  std::string what;
+  if(!m_parameters.stage(batch, &what))
+  {
+    CNR_ERROR(m_logger, "writeParams: " << what << ", the batch is refused");
+    return false;
+  }
+  CNR_INFO(m_logger, "writeParams: " << batch.size() << " parameters staged, applied at the next cycle");
+  return true;
+}
+
+void RobotHW::indexResourceNames()
+{
+  m_resource_index.assign(m_resource_names);
+  m_claimed_resources.resize(m_resource_names.size());
+  m_controller_resources.resize(m_resource_names.size());
+}
+
+void RobotHW::startBackgroundThread()
+{
+  if(m_background_thread.joinable())
+  {
+    return;
+  }
+  m_stop_background = false;
+  m_background_thread = std::thread(&RobotHW::backgroundLoop, this);
+}
+
+void RobotHW::stopBackgroundThread()
+{
+  m_stop_background = true;
+  if(m_callbacks_thread.joinable())
+  {
+    m_callbacks_thread.join();
+  }
+  if(m_background_thread.joinable())
+  {
+    m_background_thread.join();
+  }
+  flushRTLog();
+  flushStateTransitions();
+  flushStatusSnapshots();
+}
+
+// THE BACKGROUND THREAD DOES THE NO-RT WORK ON BEHALF OF THE RT METHODS
+void RobotHW::backgroundLoop()
+{
+  while(!m_stop_background)
+  {
+    flushRTLog();
+    flushStateTransitions();
+    flushStatusSnapshots();
+    flushBlackBox();
+    m_params_queue.callAvailable();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+void RobotHW::flushBlackBox()
+{
+  if(!m_black_box.triggered())
+  {
+    return;
+  }
+
+  std::stringstream path;
+  path << m_black_box_directory << "/" << m_robot_name << "_" << ros::WallTime::now().toNSec() << ".bbx";
+  std::string what;
+  if(m_black_box.dump(path.str(), &what))
+  {
+    CNR_WARN(m_logger, "Black box dumped in '" << path.str() << "'");
+  }
+  else
+  {
+    CNR_ERROR(m_logger, "Black box dump failed: " << what);
+  }
+}
+
+bool RobotHW::dumpBlackBox()
+{
+  if(!m_black_box.enabled())
+  {
+    return false;
+  }
+  m_black_box.trigger(getState());
   return true;
 }
 
+void RobotHW::callbacksLoop()
+{
+  while(!m_stop_background)
+  {
+    m_robot_hw_queue.callAvailable(ros::WallDuration(0.01));
+  }
+}
+
+void RobotHW::flushRTLog()
+{
+  // consecutive equal messages are collapsed, since an error in the RT loop is usually repeated at each cycle
+  cnr_hardware_interface::RTLogRecord record;
+  cnr_hardware_interface::RTLogRecord last;
+  std::size_t repeated = 0;
+  auto forward = [this](const cnr_hardware_interface::RTLogRecord& r, const std::size_t times)
+  {
+    std::stringstream msg;
+    msg << "[RT] " << r.msg;
+    if(times > 1)
+    {
+      msg << " (repeated " << times << " times)";
+    }
+    switch(r.level)
+    {
+      case cnr_hardware_interface::RTLogLevel::DEBUG: CNR_DEBUG(m_logger, msg.str()); break;
+      case cnr_hardware_interface::RTLogLevel::INFO:  CNR_INFO(m_logger, msg.str());  break;
+      case cnr_hardware_interface::RTLogLevel::WARN:  CNR_WARN(m_logger, msg.str());  break;
+      case cnr_hardware_interface::RTLogLevel::ERROR: CNR_ERROR(m_logger, msg.str()); break;
+      default:                                        CNR_FATAL(m_logger, msg.str()); break;
+    }
+  };
+
+  while(m_rt_log.pop(record))
+  {
+    if(repeated > 0 && record.level == last.level && std::strcmp(record.msg, last.msg) == 0)
+    {
+      repeated++;
+      continue;
+    }
+    if(repeated > 0)
+    {
+      forward(last, repeated);
+    }
+    last = record;
+    repeated = 1;
+  }
+  if(repeated > 0)
+  {
+    forward(last, repeated);
+  }
+
+  uint64_t dropped = m_rt_log.dropped();
+  if(dropped != m_rt_log_reported_drops)
+  {
+    CNR_WARN(m_logger, "[RT] " << (dropped - m_rt_log_reported_drops) << " log records dropped (ring of "
+                        << m_rt_log.capacity() << " records full), " << dropped << " in total");
+    m_rt_log_reported_drops = dropped;
+  }
+}
+
+void RobotHW::flushStateTransitions()
+{
+  cnr_hardware_interface::StateTransition t;
+  while(m_state_history.pop(t))
+  {
+    std::stringstream report;
+    const std::string transition = cnr_hardware_interface::to_string(t.from) + " -> "
+                                 + cnr_hardware_interface::to_string(t.to);
+    const std::string stamp = std::to_string(static_cast<double>(t.stamp_ns) * 1e-9);
+    if(t.accepted)
+    {
+      addDiagnosticsMessage("OK", "State transition " + transition, { {"Transition", transition},  //NOLINT
+                                                                      {"Stamp [s]", stamp} }, &report);
+      CNR_DEBUG(m_logger, report.str());
+    }
+    else
+    {
+      addDiagnosticsMessage("WARNING", "Refused state transition " + transition, { {"Transition", transition},  //NOLINT
+                                                                                   {"Stamp [s]", stamp} }, &report);
+      CNR_WARN(m_logger, report.str());
+    }
+  }
+
+  uint64_t dropped = m_state_history.dropped();
+  if(dropped != m_state_history_reported_drops)
+  {
+    CNR_WARN(m_logger, (dropped - m_state_history_reported_drops) << " state transitions not recorded (ring of "
+                        << m_state_history.capacity() << " records full)");
+    m_state_history_reported_drops = dropped;
+  }
+}
+
+// THE SNAPSHOTS ARE STORED IN ORDER, AND EACH ONE ONLY ONCE, ALSO IF REQUESTED MANY TIMES SINCE THE LAST FLUSH
+void RobotHW::flushStatusSnapshots()
+{
+  std::lock_guard<std::mutex> lock(m_status_snapshots_mutex);
+  uint64_t first_stamp_ns = 0;
+  const uint32_t pending = m_status_snapshots.take(first_stamp_ns);
+  if(pending == 0 || !m_set_status_param)
+  {
+    return;
+  }
+  for(uint32_t i = 0; i < static_cast<uint32_t>(cnr_hardware_interface::StatusSnapshot::COUNT); i++)
+  {
+    const cnr_hardware_interface::StatusSnapshot snapshot = static_cast<cnr_hardware_interface::StatusSnapshot>(i);
+    if(cnr_hardware_interface::StatusSnapshotRequests::has(pending, snapshot))
+    {
+      m_set_status_param(cnr_hardware_interface::to_string(snapshot));
+    }
+  }
+  const uint64_t now = cnr_hardware_interface::monotonicNs();
+  if(first_stamp_ns > 0 && first_stamp_ns <= now)
+  {
+    m_last_persist_latency = static_cast<double>(now - first_stamp_ns) * 1e-9;
+  }
+}
+
+void RobotHW::diagnosticsTiming(diagnostic_updater::DiagnosticStatusWrapper& stat)
+{
+  static const double quantiles[3] = {0.5, 0.99, 0.999};
+
+  stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "RobotHW '" + m_robot_name + "' timing");
+  stat.add("State", cnr_hardware_interface::to_string(getState()));
+  stat.add("RT Log Dropped", m_rt_log.dropped());
+  stat.add("State Transitions Dropped", m_state_history.dropped());
+  stat.add("Persist Queue Depth", m_status_snapshots.depth());
+  stat.add("Persist Coalesced", m_status_snapshots.coalesced());
+  stat.add("Last Persist Latency [ms]", m_last_persist_latency * 1e3);
+  if(m_command_limits_enabled)
+  {
+    stat.add("Command Saturations", m_command_limits.saturations());
+    stat.add("Stale Commands", m_command_limits.staleEvents());
+    stat.add("Non-finite Commands", m_command_limits.invalidEvents());
+    stat.add("Held Joints", m_command_limits.heldJoints());
+    if(m_command_limits.staleEvents() > 0)
+    {
+      stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "stale commands detected by the watchdog");
+    }
+    if(m_command_limits.invalidEvents() > 0)
+    {
+      stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "non-finite commands replaced by a hold");
+    }
+  }
+  if(m_black_box.enabled())
+  {
+    stat.add("Black Box Samples", m_black_box.capacity());
+    stat.add("Black Box Dumps", m_black_box.dumps());
+  }
+  if(cnr_hardware_interface::rtAllocTrackingEnabled())
+  {
+    stat.add("RT Sections", m_rt_alloc_stats.sections());
+    stat.add("RT Heap Allocations", m_rt_alloc_stats.allocations());
+    stat.add("RT Heap Allocations Worst Section", m_rt_alloc_stats.worstAllocations());
+    stat.add("RT Lock Acquisitions", m_rt_alloc_stats.locks());
+    stat.add("RT Minor Page Faults", m_rt_alloc_stats.minorFaults());
+    stat.add("RT Major Page Faults", m_rt_alloc_stats.majorFaults());
+    if(m_rt_alloc_stats.allocations() > 0 || m_rt_alloc_stats.majorFaults() > 0)
+    {
+      stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "heap allocations or page faults in the RT methods");
+    }
+  }
+  for(std::size_t i = 0; i < m_sub_devices.size(); i++)
+  {
+    const cnr_hardware_interface::SubDeviceScheduler::SubDevice& device = m_sub_devices.device(i);
+    for(std::size_t s = 0; s < static_cast<std::size_t>(cnr_hardware_interface::SubDeviceScheduler::Stage::COUNT); s++)
+    {
+      if(!device.callbacks[s])
+      {
+        continue;
+      }
+      const cnr_hardware_interface::SubDeviceStats& st = device.stats[s];
+      const std::string label = "Sub-device " + device.name + (s == 0 ? " Read" : " Write");
+      const uint64_t calls = st.calls.load(std::memory_order_relaxed);
+      stat.add(label + " calls",     calls);
+      stat.add(label + " overruns",  st.overruns.load(std::memory_order_relaxed));
+      stat.add(label + " failures",  st.failures.load(std::memory_order_relaxed));
+      stat.add(label + " mean [ms]", calls > 0 ? st.total_ns.load(std::memory_order_relaxed) * 1e-6 / calls : 0.0);
+      stat.add(label + " max [ms]",  st.max_ns.load(std::memory_order_relaxed) * 1e-6);
+      if(st.overruns.load(std::memory_order_relaxed) > 0)
+      {
+        stat.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "sub-device overruns");
+      }
+    }
+  }
+  for(std::size_t i = 0; i < cnr_hardware_interface::PhaseTimingStats::kPhases; i++)
+  {
+    const cnr_hardware_interface::RTPhase phase = static_cast<cnr_hardware_interface::RTPhase>(i);
+    const std::string label = std::string(cnr_hardware_interface::to_string(phase)) + " Time";
+    const cnr_hardware_interface::WindowStatistics window = m_phase_timing->statistics(phase);
+    const cnr_hardware_interface::LatencyHistogram& hist = m_phase_timing->histogram(phase);
+
+    double percentiles[3];
+    hist.percentiles(quantiles, 3, percentiles);
+
+    stat.add(label + " mean [ms]",   window.mean * 1e3);
+    stat.add(label + " max [ms]",    window.max * 1e3);
+    stat.add(label + " min [ms]",    window.min * 1e3);
+    stat.add(label + " jitter [ms]", window.jitter * 1e3);
+    stat.add(label + " samples",     hist.count());
+    stat.add(label + " p50 [ms]",    percentiles[0] * 1e3);
+    stat.add(label + " p99 [ms]",    percentiles[1] * 1e3);
+    stat.add(label + " p99.9 [ms]",  percentiles[2] * 1e3);
+    stat.add(label + " peak [ms]",   hist.max() * 1e3);
+  }
+}
+
 bool RobotHW::setState(const cnr_hardware_interface::StatusHw& status) const
 {
-  // if((m_state_history.size() == 0) || (m_state_history.back() != cnr_hardware_interface::to_string(getState())))
-  // {
-  //   m_state_history.push_back(cnr_hardware_interface::to_string(getState()));
-  // }
-  m_state_prev = m_state;
-  m_state = status;
+  cnr_hardware_interface::StatusHw from = m_state.load(std::memory_order_acquire);
+  do
+  {
+    if(!cnr_hardware_interface::isValidTransition(from, status))
+    {
+      m_state_history.push(from, status, false);
+      return false;
+    }
+  }
+  while(!m_state.compare_exchange_weak(from, status, std::memory_order_acq_rel, std::memory_order_acquire));
+
+  m_state_prev.store(from, std::memory_order_release);
+  if(from != status)
+  {
+    m_state_history.push(from, status, true);
+    if(m_black_box.enabled() && (status == cnr_hardware_interface::ERROR || status == cnr_hardware_interface::CTRL_ERROR))
+    {
+      m_black_box.trigger(status);
+    }
+  }
   return true;
 }
 
@@ -0,0 +1,251 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Heap allocation and lock tracking of the RT sections, see rt_alloc_guard.h.
+// The hooks are compiled only with -DCNR_HW_RT_ALLOC_CHECK=ON: the replaced operator new and the interposed
+// pthread_mutex_lock are process-wide, and they are resolved before the ones of libstdc++/libc only if this library
+// comes first in the symbol lookup (i.e. it is linked by the executable, or loaded with LD_PRELOAD).
+// All the overloads of operator new are replaced (plain, array, nothrow, and the aligned ones when the file is
+// built with -faligned-new, as CMakeLists.txt does), so that none is silently not counted.
+
+#include <cstdlib>
+#include <new>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <cnr_hardware_interface/internal/rt_alloc_guard.h>
+
+#if defined(CNR_HARDWARE_INTERFACE_RT_ALLOC_CHECK)
+#include <dlfcn.h>
+#include <pthread.h>
+
+namespace
+{
+thread_local uint64_t tl_allocations = 0;
+thread_local uint64_t tl_locks       = 0;
+thread_local int      tl_depth       = 0;
+thread_local bool     tl_abort       = false;
+
+inline void* trackedAlloc(std::size_t size)
+{
+  ++tl_allocations;
+  if (tl_abort)
+  {
+    std::abort();
+  }
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+#if defined(__cpp_aligned_new)
+inline void* trackedAlignedAlloc(std::size_t size, const std::align_val_t alignment)
+{
+  ++tl_allocations;
+  if (tl_abort)
+  {
+    std::abort();
+  }
+  std::size_t a = static_cast<std::size_t>(alignment);
+  a = a < sizeof(void*) ? sizeof(void*) : a;
+  void* p = nullptr;
+  return posix_memalign(&p, a, size == 0 ? 1 : size) == 0 ? p : nullptr;
+}
+#endif
+
+typedef int (*PthreadMutexLockFcn)(pthread_mutex_t*);
+std::atomic<PthreadMutexLockFcn> g_next_pthread_mutex_lock(nullptr);
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+  void* p = trackedAlloc(size);
+  if (!p)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return trackedAlloc(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return trackedAlloc(size);
+}
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+#if defined(__cpp_aligned_new)
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+  void* p = trackedAlignedAlloc(size, alignment);
+  if (!p)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return operator new(size, alignment);
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return trackedAlignedAlloc(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return trackedAlignedAlloc(size, alignment);
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+#endif
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+  PthreadMutexLockFcn next = g_next_pthread_mutex_lock.load(std::memory_order_acquire);
+  if (!next)
+  {
+    next = reinterpret_cast<PthreadMutexLockFcn>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    g_next_pthread_mutex_lock.store(next, std::memory_order_release);
+  }
+  ++tl_locks;
+  return next(mutex);
+}
+#endif
+
+namespace cnr_hardware_interface
+{
+
+bool rtAllocTrackingEnabled()
+{
+#if defined(CNR_HARDWARE_INTERFACE_RT_ALLOC_CHECK)
+  return true;
+#else
+  return false;
+#endif
+}
+
+#if defined(CNR_HARDWARE_INTERFACE_RT_ALLOC_CHECK)
+RTAllocGuard::RTAllocGuard(RTAllocStats& stats)
+  : stats_(stats), outermost_(tl_depth++ == 0), allocations_(0), locks_(0), minor_faults_(0), major_faults_(0)
+{
+  if (!outermost_)
+  {
+    return;
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  minor_faults_ = static_cast<uint64_t>(usage.ru_minflt);
+  major_faults_ = static_cast<uint64_t>(usage.ru_majflt);
+  locks_        = tl_locks;
+  allocations_  = tl_allocations;
+  tl_abort      = stats_.abortOnAllocation();
+}
+
+RTAllocGuard::~RTAllocGuard()
+{
+  tl_depth--;
+  if (!outermost_)
+  {
+    return;
+  }
+  tl_abort = false;
+  const uint64_t allocations = tl_allocations - allocations_;
+  const uint64_t locks       = tl_locks - locks_;
+  struct rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  stats_.add(allocations, locks, static_cast<uint64_t>(usage.ru_minflt) - minor_faults_,
+             static_cast<uint64_t>(usage.ru_majflt) - major_faults_);
+}
+#else
+RTAllocGuard::RTAllocGuard(RTAllocStats& stats)
+  : stats_(stats), outermost_(false), allocations_(0), locks_(0), minor_faults_(0), major_faults_(0)
+{
+}
+
+RTAllocGuard::~RTAllocGuard()
+{
+}
+#endif
+
+}  // namespace cnr_hardware_interface
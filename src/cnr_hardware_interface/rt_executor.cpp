@@ -0,0 +1,395 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <cnr_hardware_interface/rt_executor.h>
+
+namespace cnr_hardware_interface
+{
+
+namespace
+{
+const int64_t kNsPerSec = 1000000000LL;
+
+int64_t toNs(const struct timespec& t)
+{
+  return static_cast<int64_t>(t.tv_sec) * kNsPerSec + static_cast<int64_t>(t.tv_nsec);
+}
+
+struct timespec toTimespec(const int64_t ns)
+{
+  struct timespec t;
+  t.tv_sec  = static_cast<time_t>(ns / kNsPerSec);
+  t.tv_nsec = static_cast<long>(ns % kNsPerSec);  // NOLINT(runtime/int)
+  return t;
+}
+
+int64_t monotonicNow()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return toNs(t);
+}
+
+// touch the stack that the loop can use, so that it is mapped before the first cycle
+void prefaultStack()
+{
+  volatile unsigned char stack[64 * 1024];
+  for (std::size_t i = 0; i < sizeof(stack); i += 4096)
+  {
+    stack[i] = 0;
+  }
+}
+}  // namespace
+
+RTExecutor::RTExecutor(const RobotHWSharedPtr& hw, const UpdateFcn& update, const RTExecutorOptions& options)
+  : RTExecutor(std::vector<RTMember>(1, RTMember(hw)), update, options)
+{
+}
+
+RTExecutor::RTExecutor(const std::vector<RTMember>& members, const UpdateFcn& update,
+                       const RTExecutorOptions& options)
+  : members_(members), update_(update), options_(options),
+    data_(std::make_shared<MainThreadSharedData>(options.window_dim)),
+    stop_(true), running_(false), cycles_(0), missed_cycles_(0)
+{
+}
+
+RTExecutor::~RTExecutor()
+{
+  stop();
+}
+
+bool RTExecutor::start(std::string* what)
+{
+  if (thread_.joinable())
+  {
+    if (what)
+    {
+      *what = "The RT loop is already running";
+    }
+    return false;
+  }
+  for (const RTMember& m : members_)
+  {
+    if (!m.hw)
+    {
+      if (what)
+      {
+        *what = "Null RobotHW";
+      }
+      return false;
+    }
+  }
+
+  const double period = options_.period > 0 ? options_.period
+                      : !members_.empty() ? members_.front().hw->getSamplingPeriod() : 0.0;
+  if (period <= 0)
+  {
+    if (what)
+    {
+      *what = "The period of the RT loop must be positive";
+    }
+    return false;
+  }
+  options_.period = period;
+  data_->setCycleTime(period);
+  member_periods_.clear();
+  for (const RTMember& m : members_)
+  {
+    member_periods_.push_back(ros::Duration(period * m.divisor));
+  }
+
+  if (options_.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+  {
+    if (what)
+    {
+      *what = std::string("mlockall failed: ") + std::strerror(errno);
+    }
+    return false;
+  }
+
+  std::promise<bool> started;
+  std::future<bool> ok = started.get_future();
+  stop_ = false;
+  thread_ = std::thread(&RTExecutor::loop, this, &started);
+  if (!ok.get())
+  {
+    thread_.join();
+    if (what)
+    {
+      *what = start_error_;
+    }
+    return false;
+  }
+  return true;
+}
+
+void RTExecutor::stop()
+{
+  stop_ = true;
+  if (thread_.joinable())
+  {
+    thread_.join();
+  }
+}
+
+bool RTExecutor::isRunning() const
+{
+  return running_;
+}
+
+uint64_t RTExecutor::cycles() const
+{
+  return cycles_.load(std::memory_order_relaxed);
+}
+
+uint64_t RTExecutor::missedCycles() const
+{
+  return missed_cycles_.load(std::memory_order_relaxed);
+}
+
+std::shared_ptr<MainThreadSharedData> RTExecutor::sharedData() const
+{
+  return data_;
+}
+
+bool RTExecutor::configureThread(std::string& what)
+{
+  if (!options_.cpus.empty())
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : options_.cpus)
+    {
+      CPU_SET(cpu, &set);
+    }
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+    {
+      what = std::string("pthread_setaffinity_np failed: ") + std::strerror(err);
+      return false;
+    }
+  }
+  if (options_.priority > 0)
+  {
+    struct sched_param param;
+    param.sched_priority = options_.priority;
+    const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0)
+    {
+      what = std::string("pthread_setschedparam(SCHED_FIFO) failed: ") + std::strerror(err)
+           + " (check the rtprio limit of the user)";
+      return false;
+    }
+  }
+  return true;
+}
+
+void RTExecutor::loop(std::promise<bool>* started)
+{
+  if (!configureThread(start_error_))
+  {
+    started->set_value(false);
+    return;
+  }
+  if (options_.lock_memory)
+  {
+    prefaultStack();
+  }
+  for (const RTMember& m : members_)
+  {
+    if (!m.hw->initRT())
+    {
+      start_error_ = "initRT() of the RobotHW '" + m.hw->getRobotHwNamespace() + "' failed";
+      started->set_value(false);
+      return;
+    }
+  }
+  running_ = true;
+  started->set_value(true);  // 'started' is not valid anymore since now
+
+  const int64_t period_ns = static_cast<int64_t>(options_.period * 1e9);
+  const ros::Duration period(options_.period);
+  const std::size_t n = members_.size();
+  int64_t next = options_.start_ns > 0 ? options_.start_ns - period_ns : monotonicNow();
+  int64_t last_wakeup = 0;
+  uint64_t cycle = 0;
+  while (!stop_)
+  {
+    next += period_ns;
+    const struct timespec deadline = toTimespec(next);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+    {
+    }
+    if (stop_)
+    {
+      break;  // e.g. stopped while waiting for the start_ns of a CombinedRTExecutor
+    }
+
+    const int64_t wakeup = monotonicNow();
+    const ros::Time time = ros::Time::now();
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (cycle % members_[i].divisor == members_[i].phase)
+      {
+        members_[i].hw->read(time, member_periods_[i]);
+      }
+    }
+    if (update_)
+    {
+      update_(time, period);
+    }
+    for (std::size_t i = 0; i < n; i++)
+    {
+      if (cycle % members_[i].divisor == members_[i].phase)
+      {
+        members_[i].hw->write(time, member_periods_[i]);
+      }
+    }
+    const int64_t end = monotonicNow();
+
+    // the cycle counter follows the time, so that the phases of the members are kept also after an overrun
+    uint32_t missed = 0;
+    if (end > next + period_ns)
+    {
+      missed = static_cast<uint32_t>((end - next) / period_ns);
+      next += static_cast<int64_t>(missed) * period_ns;
+    }
+    cycle += 1 + missed;
+
+    data_->setLatencyTime(static_cast<double>(wakeup - toNs(deadline)) * 1e-9);
+    if (last_wakeup > 0)
+    {
+      data_->setActualCycleTime(static_cast<double>(wakeup - last_wakeup) * 1e-9);
+    }
+    data_->setCalcTime(static_cast<double>(end - wakeup) * 1e-9);
+    data_->setMissedCycles(missed);
+    last_wakeup = wakeup;
+
+    cycles_.store(cycles_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    missed_cycles_.store(missed_cycles_.load(std::memory_order_relaxed) + missed, std::memory_order_relaxed);
+  }
+  running_ = false;
+}
+
+// ======================================================= CombinedRTExecutor
+CombinedRTExecutor::~CombinedRTExecutor()
+{
+  stop();
+}
+
+bool CombinedRTExecutor::addGroup(const std::string& group, const RTExecutor::UpdateFcn& update,
+                                  const RTExecutorOptions& options)
+{
+  if (running_ || groups_.count(group))
+  {
+    return false;
+  }
+  Group& g = groups_[group];
+  g.update  = update;
+  g.options = options;
+  return true;
+}
+
+bool CombinedRTExecutor::addMember(const std::string& group, const RTMember& member)
+{
+  std::map<std::string, Group>::iterator it = groups_.find(group);
+  if (running_ || it == groups_.end() || !member.hw)
+  {
+    return false;
+  }
+  it->second.members.push_back(member);
+  return true;
+}
+
+bool CombinedRTExecutor::start(std::string* what)
+{
+  if (running_)
+  {
+    if (what)
+    {
+      *what = "The executor is already running";
+    }
+    return false;
+  }
+
+  // a common origin in the near future, so that all the threads are configured before the cycle 0
+  const int64_t start_ns = monotonicNow() + 100 * 1000000LL;
+  for (std::pair<const std::string, Group>& g : groups_)
+  {
+    RTExecutorOptions options = g.second.options;
+    options.start_ns = start_ns;
+    g.second.executor.reset(new RTExecutor(g.second.members, g.second.update, options));
+    std::string err;
+    if (!g.second.executor->start(&err))
+    {
+      if (what)
+      {
+        *what = "Group '" + g.first + "': " + err;
+      }
+      stop();
+      return false;
+    }
+  }
+  running_ = true;
+  return true;
+}
+
+void CombinedRTExecutor::stop()
+{
+  for (std::pair<const std::string, Group>& g : groups_)
+  {
+    if (g.second.executor)
+    {
+      g.second.executor->stop();
+      g.second.executor.reset();
+    }
+  }
+  running_ = false;
+}
+
+std::shared_ptr<MainThreadSharedData> CombinedRTExecutor::sharedData(const std::string& group) const
+{
+  std::map<std::string, Group>::const_iterator it = groups_.find(group);
+  return (it == groups_.end() || !it->second.executor) ? nullptr : it->second.executor->sharedData();
+}
+
+}  // namespace cnr_hardware_interface
@@ -0,0 +1,428 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <thread>  // NOLINT
+#include <cnr_hardware_interface/shm_state.h>
+
+namespace cnr_hardware_interface
+{
+
+namespace
+{
+
+constexpr std::size_t kMetaWords   = 3;
+constexpr std::size_t kTimingWords = 3 * PhaseTimingStats::kPhases;
+
+std::size_t digitalWords(const std::size_t n)
+{
+  return (n + 63) / 64;
+}
+
+std::size_t wordsNumber(const std::size_t joints, const std::size_t analogs, const std::size_t force_torques,
+                        const std::size_t digitals)
+{
+  return kMetaWords + kTimingWords + 6 * joints + 2 * analogs + 2 * HardwareBuffer::kWrenchSize * force_torques
+         + 2 * digitalWords(digitals);
+}
+
+std::size_t namesOffset()
+{
+  return sizeof(ShmStateHeader);
+}
+
+std::size_t dataOffset(const std::size_t names)
+{
+  const std::size_t end = namesOffset() + names * ShmStateHeader::kNameSize;
+  return (end + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+}
+
+uint64_t toWord(const double v)
+{
+  uint64_t w;
+  std::memcpy(&w, &v, sizeof(w));
+  return w;
+}
+
+double toDouble(const uint64_t w)
+{
+  double v;
+  std::memcpy(&v, &w, sizeof(v));
+  return v;
+}
+
+void storeColumn(std::atomic<uint64_t>*& dst, const double* src, const std::size_t n)
+{
+  for (std::size_t i = 0; i < n; i++)
+  {
+    (dst++)->store(toWord(src[i]), std::memory_order_relaxed);
+  }
+}
+
+void storeBits(std::atomic<uint64_t>*& dst, const AlignedColumn<bool>& src)
+{
+  for (std::size_t w = 0; w < digitalWords(src.size()); w++)
+  {
+    uint64_t word = 0;
+    for (std::size_t b = 0; b < 64 && w * 64 + b < src.size(); b++)
+    {
+      word |= static_cast<uint64_t>(src[w * 64 + b] ? 1U : 0U) << b;
+    }
+    (dst++)->store(word, std::memory_order_relaxed);
+  }
+}
+
+void loadColumn(const uint64_t*& src, std::vector<double>& dst, const std::size_t n)
+{
+  dst.resize(n);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    dst[i] = toDouble(*src++);
+  }
+}
+
+void loadBits(const uint64_t*& src, std::vector<bool>& dst, const std::size_t n)
+{
+  dst.resize(n);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    dst[i] = (src[i / 64] >> (i % 64)) & 1U;
+  }
+  src += digitalWords(n);
+}
+
+void setError(std::string* what, const std::string& msg)
+{
+  if (what)
+  {
+    *what = msg;
+  }
+}
+
+}  // namespace
+
+ShmStatePublisher::ShmStatePublisher() : map_(nullptr), size_(0), header_(nullptr), words_(nullptr)
+{
+}
+
+ShmStatePublisher::~ShmStatePublisher()
+{
+  close();
+}
+
+bool ShmStatePublisher::create(const std::string& name, const HardwareBuffer& buffer, std::string* what)
+{
+  close();
+
+  const std::size_t joints   = buffer.jointNumber();
+  const std::size_t analogs  = buffer.analogNames().size();
+  const std::size_t fts      = buffer.forceTorqueNames().size();
+  const std::size_t digitals = buffer.digitalNames().size();
+  const std::size_t names    = joints + analogs + fts + digitals;
+  const std::size_t words    = wordsNumber(joints, analogs, fts, digitals);
+  const std::size_t size     = dataOffset(names) + words * sizeof(uint64_t);
+
+  int fd = ::shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    setError(what, "shm_open('" + name + "') failed: " + std::strerror(errno));
+    return false;
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+  {
+    setError(what, "ftruncate('" + name + "') failed: " + std::strerror(errno));
+    ::close(fd);
+    ::shm_unlink(name.c_str());
+    return false;
+  }
+  void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+  {
+    setError(what, "mmap('" + name + "') failed: " + std::strerror(errno));
+    ::shm_unlink(name.c_str());
+    return false;
+  }
+
+  char* base = static_cast<char*>(map);
+  ShmStateHeader* header = new (base) ShmStateHeader;
+  header->magic.store(0, std::memory_order_relaxed);
+  header->version       = ShmStateHeader::kVersion;
+  header->joints        = static_cast<uint32_t>(joints);
+  header->analogs       = static_cast<uint32_t>(analogs);
+  header->force_torques = static_cast<uint32_t>(fts);
+  header->digitals      = static_cast<uint32_t>(digitals);
+  header->words_number  = static_cast<uint32_t>(words);
+  header->seq.store(0, std::memory_order_relaxed);
+
+  char* n = base + namesOffset();
+  for (const std::vector<std::string>* v : { &buffer.jointNames(), &buffer.analogNames(), &buffer.forceTorqueNames(),
+                                             &buffer.digitalNames() })
+  {
+    for (const std::string& s : *v)
+    {
+      std::strncpy(n, s.c_str(), ShmStateHeader::kNameSize - 1);
+      n += ShmStateHeader::kNameSize;
+    }
+  }
+
+  std::atomic<uint64_t>* data = reinterpret_cast<std::atomic<uint64_t>*>(base + dataOffset(names));
+  for (std::size_t i = 0; i < words; i++)
+  {
+    new (data + i) std::atomic<uint64_t>(0);
+  }
+
+  // Pre-fault the pages, so that the first publish() in the RT loop does not page fault
+  ::mlock(map, size);
+
+  name_   = name;
+  map_    = map;
+  size_   = size;
+  header_ = header;
+  words_  = data;
+  header_->magic.store(ShmStateHeader::kMagic, std::memory_order_release);
+  return true;
+}
+
+void ShmStatePublisher::close()
+{
+  if (map_)
+  {
+    header_->magic.store(0, std::memory_order_release);
+    ::munlock(map_, size_);
+    ::munmap(map_, size_);
+    ::shm_unlink(name_.c_str());
+  }
+  map_    = nullptr;
+  size_   = 0;
+  header_ = nullptr;
+  words_  = nullptr;
+  name_.clear();
+}
+
+void ShmStatePublisher::publish(const uint64_t cycle, const StatusHw& state, const PhaseTimingStats& timing,
+                                const HardwareBuffer& buffer)
+{
+  if (!header_ || buffer.jointNumber() != header_->joints || buffer.forceTorqueNames().size() != header_->force_torques)
+  {
+    return;
+  }
+
+  WindowStatistics stats[PhaseTimingStats::kPhases];
+  for (std::size_t i = 0; i < PhaseTimingStats::kPhases; i++)
+  {
+    stats[i] = timing.statistics(static_cast<RTPhase>(i));
+  }
+
+  const uint64_t s = header_->seq.load(std::memory_order_relaxed);
+  header_->seq.store(s + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::atomic<uint64_t>* w = words_;
+  (w++)->store(cycle, std::memory_order_relaxed);
+  (w++)->store(monotonicNs(), std::memory_order_relaxed);
+  (w++)->store(static_cast<uint64_t>(state), std::memory_order_relaxed);
+  for (std::size_t i = 0; i < PhaseTimingStats::kPhases; i++)
+  {
+    (w++)->store(toWord(stats[i].last), std::memory_order_relaxed);
+    (w++)->store(toWord(stats[i].mean), std::memory_order_relaxed);
+    (w++)->store(toWord(stats[i].max), std::memory_order_relaxed);
+  }
+  const std::size_t nj = header_->joints;
+  storeColumn(w, buffer.position().data(), nj);
+  storeColumn(w, buffer.velocity().data(), nj);
+  storeColumn(w, buffer.effort().data(), nj);
+  storeColumn(w, buffer.commandPosition().data(), nj);
+  storeColumn(w, buffer.commandVelocity().data(), nj);
+  storeColumn(w, buffer.commandEffort().data(), nj);
+  storeColumn(w, buffer.analogValue().data(), header_->analogs);
+  storeColumn(w, buffer.analogCommand().data(), header_->analogs);
+  storeColumn(w, buffer.wrench().data(), HardwareBuffer::kWrenchSize * header_->force_torques);
+  storeColumn(w, buffer.wrenchCommand().data(), HardwareBuffer::kWrenchSize * header_->force_torques);
+  storeBits(w, buffer.digitalValue());
+  storeBits(w, buffer.digitalCommand());
+
+  header_->seq.store(s + 2, std::memory_order_release);
+}
+
+ShmStateReader::ShmStateReader() : map_(nullptr), size_(0), header_(nullptr), words_(nullptr)
+{
+}
+
+ShmStateReader::~ShmStateReader()
+{
+  close();
+}
+
+bool ShmStateReader::open(const std::string& name, std::string* what)
+{
+  close();
+
+  int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+  {
+    setError(what, "shm_open('" + name + "') failed: " + std::strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(ShmStateHeader))
+  {
+    setError(what, "the segment '" + name + "' is not ready");
+    ::close(fd);
+    return false;
+  }
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+  {
+    setError(what, "mmap('" + name + "') failed: " + std::strerror(errno));
+    return false;
+  }
+
+  const char* base = static_cast<const char*>(map);
+  const ShmStateHeader* header = reinterpret_cast<const ShmStateHeader*>(base);
+  const std::size_t names = header->joints + header->analogs + header->force_torques + header->digitals;
+  if (header->magic.load(std::memory_order_acquire) != ShmStateHeader::kMagic
+      || header->version != ShmStateHeader::kVersion
+      || header->words_number != wordsNumber(header->joints, header->analogs, header->force_torques, header->digitals)
+      || size < dataOffset(names) + header->words_number * sizeof(uint64_t))
+  {
+    setError(what, "the segment '" + name + "' is not ready, or it has an unknown layout");
+    ::munmap(map, size);
+    return false;
+  }
+
+  const char* n = base + namesOffset();
+  auto names_of = [&n](std::vector<std::string>& v, const std::size_t count)
+  {
+    v.clear();
+    for (std::size_t i = 0; i < count; i++)
+    {
+      v.push_back(std::string(n, ::strnlen(n, ShmStateHeader::kNameSize)));
+      n += ShmStateHeader::kNameSize;
+    }
+  };
+  names_of(joint_names_, header->joints);
+  names_of(analog_names_, header->analogs);
+  names_of(ft_names_, header->force_torques);
+  names_of(digital_names_, header->digitals);
+
+  map_    = map;
+  size_   = size;
+  header_ = header;
+  words_  = reinterpret_cast<const std::atomic<uint64_t>*>(base + dataOffset(names));
+  copy_.resize(header->words_number);
+  return true;
+}
+
+void ShmStateReader::close()
+{
+  if (map_)
+  {
+    ::munmap(map_, size_);
+  }
+  map_    = nullptr;
+  size_   = 0;
+  header_ = nullptr;
+  words_  = nullptr;
+  joint_names_.clear();
+  analog_names_.clear();
+  ft_names_.clear();
+  digital_names_.clear();
+}
+
+bool ShmStateReader::read(ShmStateSnapshot& snapshot) const
+{
+  if (!header_)
+  {
+    return false;
+  }
+
+  uint64_t s = 0;
+  do
+  {
+    s = header_->seq.load(std::memory_order_acquire);
+    while (s & 1U)
+    {
+      std::this_thread::yield();
+      s = header_->seq.load(std::memory_order_acquire);
+    }
+    for (std::size_t i = 0; i < copy_.size(); i++)
+    {
+      copy_[i] = words_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  while (header_->seq.load(std::memory_order_relaxed) != s);
+
+  if (s == 0)
+  {
+    return false;
+  }
+
+  const uint64_t* r = copy_.data();
+  snapshot.cycle    = *r++;
+  snapshot.stamp_ns = *r++;
+  snapshot.state    = static_cast<StatusHw>(*r++);
+  for (std::size_t i = 0; i < PhaseTimingStats::kPhases; i++)
+  {
+    snapshot.timing[i] = WindowStatistics();
+    snapshot.timing[i].last = toDouble(*r++);
+    snapshot.timing[i].mean = toDouble(*r++);
+    snapshot.timing[i].max  = toDouble(*r++);
+  }
+  const std::size_t nj = header_->joints;
+  loadColumn(r, snapshot.position, nj);
+  loadColumn(r, snapshot.velocity, nj);
+  loadColumn(r, snapshot.effort, nj);
+  loadColumn(r, snapshot.command_position, nj);
+  loadColumn(r, snapshot.command_velocity, nj);
+  loadColumn(r, snapshot.command_effort, nj);
+  loadColumn(r, snapshot.analog, header_->analogs);
+  loadColumn(r, snapshot.analog_command, header_->analogs);
+  loadColumn(r, snapshot.wrench, HardwareBuffer::kWrenchSize * header_->force_torques);
+  loadColumn(r, snapshot.wrench_command, HardwareBuffer::kWrenchSize * header_->force_torques);
+  loadBits(r, snapshot.digital, header_->digitals);
+  loadBits(r, snapshot.digital_command, header_->digitals);
+  return true;
+}
+
+}  // namespace cnr_hardware_interface
@@ -0,0 +1,255 @@
+/*
+ *  Software License Agreement (New BSD License)
+ *
+ *  Copyright 2020 National Council of Research of Italy (CNR)
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Benchmarks of the RobotHW hot paths, on a mock RobotHW whose doRead()/doWrite() only copy the HardwareBuffer.
+//
+//   rosrun cnr_hardware_interface cnr_hardware_interface_bench --benchmark_format=json --benchmark_out=bench.json
+//
+// RobotHW holds ros::NodeHandle members, so a roscore has to be running (the bench stops at once if none is). The
+// bench sets the parameters of the logger of the mock itself (screen only, errors only), so that the numbers do not
+// depend on the configuration found in the parameter server, nor include the default setup of cnr_logger.
+
+#include <iostream>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <ros/ros.h>
+#include <cnr_hardware_interface/cnr_robot_hw.h>
+#include <cnr_hardware_interface/hardware_buffer.h>
+
+namespace
+{
+
+const char kLoggerNamespace[] = "/cnr_hardware_interface_bench";
+
+void setLoggerParams()
+{
+  ros::param::set(std::string(kLoggerNamespace) + "/appenders", std::vector<std::string>({"screen"}));
+  ros::param::set(std::string(kLoggerNamespace) + "/levels", std::vector<std::string>({"error"}));
+}
+
+class MockRobotHW : public cnr_hardware_interface::RobotHW
+{
+public:
+  explicit MockRobotHW(const std::size_t joints)
+  {
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < joints; i++)
+    {
+      names.push_back("joint_" + std::to_string(i));
+    }
+    std::string what;
+    if (!m_logger.init("bench_hw", kLoggerNamespace, false, false, &what))
+    {
+      throw std::runtime_error("logger of the bench not configured: " + what);
+    }
+    setResourceNames(names);
+    m_buffer.resize(names);
+    m_buffer.registerHandles(m_pve_iface);
+    m_bus_state.assign(joints, 0.1);
+    m_bus_command.assign(joints, 0.0);
+    setRTMode(true);
+    setState(cnr_hardware_interface::INITIALIZED);
+  }
+
+  hardware_interface::PosVelEffJointInterface& pveInterface()
+  {
+    return m_pve_iface;
+  }
+
+protected:
+  bool doRead(const ros::Time& /*time*/, const ros::Duration& /*period*/) override
+  {
+    std::copy(m_bus_state.begin(), m_bus_state.end(), m_buffer.position().begin());
+    std::copy(m_bus_state.begin(), m_bus_state.end(), m_buffer.velocity().begin());
+    std::copy(m_bus_state.begin(), m_bus_state.end(), m_buffer.effort().begin());
+    return true;
+  }
+  bool doWrite(const ros::Time& /*time*/, const ros::Duration& /*period*/) override
+  {
+    std::copy(m_buffer.commandPosition().begin(), m_buffer.commandPosition().end(), m_bus_command.begin());
+    return true;
+  }
+
+private:
+  hardware_interface::PosVelEffJointInterface m_pve_iface;
+  std::vector<double>                         m_bus_state;
+  std::vector<double>                         m_bus_command;
+};
+
+// Each controller claims joints / controllers joints, through the PosVelEffJointInterface
+std::list<hardware_interface::ControllerInfo> makeControllers(const std::size_t controllers, const std::size_t joints)
+{
+  std::list<hardware_interface::ControllerInfo> ret;
+  const std::size_t per_controller = std::max<std::size_t>(1, joints / controllers);
+  for (std::size_t c = 0; c < controllers; c++)
+  {
+    hardware_interface::ControllerInfo info;
+    info.name = "controller_" + std::to_string(c);
+    info.type = "mock_controller";
+    hardware_interface::InterfaceResources res;
+    res.hardware_interface = "hardware_interface::PosVelEffJointInterface";
+    for (std::size_t j = c * per_controller; j < (c + 1) * per_controller && j < joints; j++)
+    {
+      res.resources.insert("joint_" + std::to_string(j));
+    }
+    info.claimed_resources.push_back(res);
+    ret.push_back(info);
+  }
+  return ret;
+}
+
+// joints x controllers
+void switchArgs(benchmark::internal::Benchmark* b)
+{
+  for (int joints : {6, 24, 96})
+  {
+    for (int controllers : {1, 4, 16})
+    {
+      b->Args({joints, controllers});
+    }
+  }
+}
+
+void BM_ReadWrite(benchmark::State& state)
+{
+  MockRobotHW hw(static_cast<std::size_t>(state.range(0)));
+  const ros::Time time(0);
+  const ros::Duration period(0.001);
+  for (auto _ : state)
+  {
+    hw.read(time, period);
+    hw.write(time, period);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadWrite)->RangeMultiplier(2)->Range(6, 96);
+
+void BM_CheckForConflict(benchmark::State& state)
+{
+  const std::size_t joints = static_cast<std::size_t>(state.range(0));
+  MockRobotHW hw(joints);
+  const std::list<hardware_interface::ControllerInfo> controllers =
+      makeControllers(static_cast<std::size_t>(state.range(1)), joints);
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(hw.checkForConflict(controllers));
+  }
+}
+BENCHMARK(BM_CheckForConflict)->Apply(switchArgs);
+
+// A full cycle: start all the controllers, then stop them
+void BM_PrepareAndDoSwitch(benchmark::State& state)
+{
+  const std::size_t joints = static_cast<std::size_t>(state.range(0));
+  MockRobotHW hw(joints);
+  const std::list<hardware_interface::ControllerInfo> controllers =
+      makeControllers(static_cast<std::size_t>(state.range(1)), joints);
+  const std::list<hardware_interface::ControllerInfo> none;
+  for (auto _ : state)
+  {
+    hw.prepareSwitch(controllers, none);
+    hw.doSwitch(controllers, none);
+    hw.prepareSwitch(none, controllers);
+    hw.doSwitch(none, controllers);
+  }
+}
+BENCHMARK(BM_PrepareAndDoSwitch)->Apply(switchArgs);
+
+void BM_HandleSetCommand(benchmark::State& state)
+{
+  const std::size_t joints = static_cast<std::size_t>(state.range(0));
+  MockRobotHW hw(joints);
+  std::vector<hardware_interface::PosVelEffJointHandle> handles;
+  for (std::size_t j = 0; j < joints; j++)
+  {
+    handles.push_back(hw.pveInterface().getHandle("joint_" + std::to_string(j)));
+  }
+  double value = 0.0;
+  for (auto _ : state)
+  {
+    for (hardware_interface::PosVelEffJointHandle& h : handles)
+    {
+      h.setCommand(value, value, value);
+    }
+    value += 1e-6;
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(joints));
+}
+BENCHMARK(BM_HandleSetCommand)->RangeMultiplier(2)->Range(6, 96);
+
+void BM_GroupHandleSetCommands(benchmark::State& state)
+{
+  const std::size_t joints = static_cast<std::size_t>(state.range(0));
+  MockRobotHW hw(joints);
+  std::vector<std::string> names;
+  for (std::size_t j = 0; j < joints; j++)
+  {
+    names.push_back("joint_" + std::to_string(j));
+  }
+  hardware_interface::PosVelEffJointGroupHandle group = hw.pveInterface().getGroupHandle(names);
+  std::vector<double> cmd(joints, 0.0);
+  for (auto _ : state)
+  {
+    group.setCommands(cmd.data(), cmd.data(), cmd.data());
+    cmd[0] += 1e-6;
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(joints));
+}
+BENCHMARK(BM_GroupHandleSetCommands)->RangeMultiplier(2)->Range(6, 96);
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "cnr_hardware_interface_bench", ros::init_options::NoRosout);
+  if (!ros::master::check())
+  {
+    std::cerr << "The RobotHW of the bench needs a roscore" << std::endl;
+    return 1;
+  }
+  setLoggerParams();
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv))
+  {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
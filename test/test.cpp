@@ -33,10 +33,41 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <ros/ros.h>
 #include <cnr_logger/cnr_logger.h>
+#include <cnr_hardware_interface/cnr_robot_hw.h>
+#include <cnr_hardware_interface/rt_executor.h>
 #include <gtest/gtest.h>
+#include <unistd.h>
+#include <thread>  // NOLINT
+#include <type_traits>
+#include <cnr_hardware_interface/internal/diagnostics.h>
+#include <cnr_hardware_interface/internal/latency_histogram.h>
+#include <cnr_hardware_interface/internal/rt_log_queue.h>
+#include <cnr_hardware_interface/internal/mailbox.h>
+#include <cnr_hardware_interface/internal/resource_index.h>
+#include <cnr_hardware_interface/internal/controller_registry.h>
+#include <cnr_hardware_interface/internal/state_transitions.h>
+#include <cnr_hardware_interface/internal/status_snapshots.h>
+#include <cnr_hardware_interface/hardware_buffer.h>
+#include <cnr_hardware_interface/internal/command_channel.h>
+#include <cnr_hardware_interface/force_torque_command_interface.h>
+#include <cnr_hardware_interface/internal/param_cache.h>
+#include <cnr_hardware_interface/shm_state.h>
+#include <cnr_hardware_interface/black_box.h>
+#include <cnr_hardware_interface/internal/parameter_block.h>
+#include <cnr_hardware_interface/internal/fixed_span.h>
+#include <cnr_hardware_interface/internal/io_change.h>
+#include <cnr_hardware_interface/internal/wrench_processing.h>
+#include <cnr_hardware_interface/internal/command_limits.h>
+#include <cnr_hardware_interface/internal/sub_devices.h>
+#include <cnr_hardware_interface/internal/rt_trace.h>
+#include <cnr_hardware_interface/internal/rt_alloc_guard.h>
+#include <sys/mman.h>
+#include <mutex>  // NOLINT
 
 std::shared_ptr<cnr_logger::TraceLogger> logger;
 
@@ -48,6 +79,1177 @@ TEST(TestSuite, fullConstructor)
   EXPECT_NO_FATAL_FAILURE(logger.reset());
 }
 
+TEST(TestSuite, mainThreadSharedData)
+{
+  MainThreadSharedData data(10);
+  EXPECT_EQ(data.getMeanActCycleTime(), 0.0);
+
+  std::thread producer([&data]
+  {
+    for (int i = 0; i < 100000; i++)
+    {
+      data.setActualCycleTime(1e-3);
+      data.setMissedCycles(i % 3);
+    }
+  });
+  for (int i = 0; i < 1000; i++)
+  {
+    double m = data.getMeanActCycleTime();
+    EXPECT_TRUE(m == 0.0 || std::fabs(m - 1.0) < 1e-9);
+  }
+  producer.join();
+
+  EXPECT_NEAR(data.getMaxActCycleTime(), 1.0, 1e-9);
+  EXPECT_EQ(data.getMaxMissedCycles(), 2u);
+  EXPECT_EQ(data.getMinMissedCycles(), 0u);
+}
+
+TEST(TestSuite, slidingWindowStats)
+{
+  cnr_hardware_interface::SlidingWindowStats stats(3);
+  for (double v : {5.0, 1.0, 3.0, 2.0})
+  {
+    stats.push(v);
+  }
+  cnr_hardware_interface::WindowStatistics s = stats.statistics();
+  EXPECT_EQ(s.samples, 3u);
+  EXPECT_DOUBLE_EQ(s.last, 2.0);
+  EXPECT_DOUBLE_EQ(s.mean, 2.0);
+  EXPECT_DOUBLE_EQ(s.max, 3.0);
+  EXPECT_DOUBLE_EQ(s.min, 1.0);
+  EXPECT_NEAR(s.variance, 2.0 / 3.0, 1e-12);
+}
+
+TEST(TestSuite, latencyHistogram)
+{
+  cnr_hardware_interface::LatencyHistogram hist;
+  for (int i = 0; i < 999; i++)
+  {
+    hist.record(1e-3);
+  }
+  hist.record(5e-3);
+
+  EXPECT_EQ(hist.count(), 1000u);
+  EXPECT_NEAR(hist.percentile(0.5), 1e-3, 1e-3 / 16.0);
+  EXPECT_NEAR(hist.percentile(0.999), 1e-3, 1e-3 / 16.0);
+  EXPECT_DOUBLE_EQ(hist.percentile(1.0), 5e-3);
+  EXPECT_DOUBLE_EQ(hist.max(), 5e-3);
+}
+
+TEST(TestSuite, rtLogQueue)
+{
+  cnr_hardware_interface::RTLogQueue queue(2);
+  EXPECT_TRUE(queue.push(cnr_hardware_interface::RTLogLevel::ERROR, "first"));
+  EXPECT_TRUE(queue.push(cnr_hardware_interface::RTLogLevel::WARN, "second"));
+  EXPECT_FALSE(queue.push(cnr_hardware_interface::RTLogLevel::WARN, "dropped"));
+  EXPECT_EQ(queue.dropped(), 1u);
+
+  cnr_hardware_interface::RTLogRecord record;
+  EXPECT_TRUE(queue.pop(record));
+  EXPECT_STREQ(record.msg, "first");
+  EXPECT_TRUE(record.level == cnr_hardware_interface::RTLogLevel::ERROR);
+  EXPECT_TRUE(queue.pop(record));
+  EXPECT_STREQ(record.msg, "second");
+  EXPECT_FALSE(queue.pop(record));
+}
+
+TEST(TestSuite, mailbox)
+{
+  cnr_hardware_interface::Mailbox<std::vector<double>> mailbox(std::vector<double>(3, 0.0));
+  EXPECT_FALSE(mailbox.fetch());
+
+  mailbox.write({1.0, 2.0, 3.0});
+  mailbox.write({4.0, 5.0, 6.0});
+  EXPECT_TRUE(mailbox.fetch());
+  EXPECT_DOUBLE_EQ(mailbox.front().at(0), 4.0);
+  EXPECT_FALSE(mailbox.fetch());
+
+  std::vector<double> value;
+  mailbox.back().assign(3, 7.0);
+  mailbox.publish();
+  EXPECT_TRUE(mailbox.read(value));
+  EXPECT_DOUBLE_EQ(value.at(2), 7.0);
+}
+
+TEST(TestSuite, resourceIndex)
+{
+  cnr_hardware_interface::ResourceIndex index;
+  index.assign({"j1", "j2", "j3"});
+  EXPECT_EQ(index.find("j2"), 1);
+  EXPECT_EQ(index.find("j4"), -1);
+
+  cnr_hardware_interface::ResourceBitset a(130), b(130);
+  a.set(129);
+  b.set(3);
+  EXPECT_FALSE(a.intersects(b));
+  b |= a;
+  EXPECT_TRUE(a.intersects(b));
+  EXPECT_TRUE(b.test(3) && b.test(129) && !b.test(64));
+  b.clear();
+  EXPECT_FALSE(b.any());
+}
+
+TEST(TestSuite, deferredSwitch)
+{
+  typedef hardware_interface::RobotHW::SwitchState SwitchState;
+  std::list<hardware_interface::ControllerInfo> active, start(2), stop;
+  start.front().name = "ctrl1";
+  start.back().name = "ctrl2";
+
+  cnr_hardware_interface::ControllerRegistry registry(active);
+  registry.beginSwitch(start, stop);
+  EXPECT_TRUE(registry.deferSwitch("ctrl2"));
+  EXPECT_FALSE(registry.deferSwitch("ctrl3"));
+  registry.endSwitch(SwitchState::DONE);
+  EXPECT_EQ(registry.pendingSwitches(), 1u);
+
+  SwitchState state;
+  EXPECT_TRUE(registry.switchState("ctrl1", state));
+  EXPECT_EQ(state, SwitchState::DONE);
+  EXPECT_TRUE(registry.switchState("ctrl2", state));
+  EXPECT_EQ(state, SwitchState::ONGOING);
+  EXPECT_FALSE(registry.completeSwitch("ctrl1", SwitchState::DONE));
+  EXPECT_TRUE(registry.completeSwitch("ctrl2", SwitchState::DONE));
+  EXPECT_TRUE(registry.switchState("ctrl2", state));
+  EXPECT_EQ(state, SwitchState::DONE);
+  EXPECT_EQ(registry.pendingSwitches(), 0u);
+
+  // the switch table is preallocated: a switch larger than it is refused
+  cnr_hardware_interface::ControllerRegistry small(active, 2);
+  std::list<hardware_interface::ControllerInfo> stop1(1);
+  stop1.front().name = "ctrl3";
+  EXPECT_TRUE(small.beginSwitch(start, {}));
+  EXPECT_FALSE(small.beginSwitch(start, stop1));
+  EXPECT_FALSE(small.switchState("ctrl1", state));
+
+  // the RT thread polls the state while the switches are prepared
+  std::atomic<bool> stop_reader(false);
+  std::thread reader([&]()
+  {
+    SwitchState s;
+    while (!stop_reader)
+    {
+      if (registry.switchState("ctrl1", s))
+      {
+        EXPECT_TRUE(s == SwitchState::ONGOING || s == SwitchState::DONE);
+      }
+      registry.deferSwitch("ctrl2");
+      registry.completeSwitch("ctrl2", SwitchState::DONE);
+    }
+  });
+  for (int i = 0; i < 1000; i++)
+  {
+    EXPECT_TRUE(registry.beginSwitch(start, stop));
+    registry.endSwitch(SwitchState::DONE);
+  }
+  stop_reader = true;
+  reader.join();
+}
+
+TEST(TestSuite, stateTransitions)
+{
+  EXPECT_TRUE(cnr_hardware_interface::isValidTransition(cnr_hardware_interface::RUNNING,
+                                                        cnr_hardware_interface::READY_TO_SWITCH));
+  EXPECT_TRUE(cnr_hardware_interface::isValidTransition(cnr_hardware_interface::DOING_SWITCH,
+                                                        cnr_hardware_interface::ERROR));
+  EXPECT_FALSE(cnr_hardware_interface::isValidTransition(cnr_hardware_interface::CREATED,
+                                                         cnr_hardware_interface::RUNNING));
+  EXPECT_TRUE(cnr_hardware_interface::isValidTransition(cnr_hardware_interface::CREATED,
+                                                        cnr_hardware_interface::INITIALIZING));
+  EXPECT_FALSE(cnr_hardware_interface::isValidTransition(cnr_hardware_interface::INITIALIZING,
+                                                         cnr_hardware_interface::READY_TO_SWITCH));
+  // the values stored by the shm segment and the black box, and used by the plugins already built
+  EXPECT_EQ(static_cast<int>(cnr_hardware_interface::INITIALIZED), 2);
+  EXPECT_EQ(static_cast<int>(cnr_hardware_interface::UNKOWN), 11);
+  EXPECT_EQ(static_cast<int>(cnr_hardware_interface::INITIALIZING), 12);
+
+  cnr_hardware_interface::StateTransitionRing ring(4);
+  std::vector<std::thread> producers;
+  for (int i = 0; i < 4; i++)
+  {
+    producers.emplace_back([&ring]()
+    {
+      for (int j = 0; j < 100; j++)
+      {
+        ring.push(cnr_hardware_interface::RUNNING, cnr_hardware_interface::READY_TO_SWITCH, true);
+      }
+    });
+  }
+  std::size_t popped = 0;
+  cnr_hardware_interface::StateTransition t;
+  for (std::thread& p : producers)
+  {
+    p.join();
+  }
+  while (ring.pop(t))
+  {
+    EXPECT_EQ(t.to, cnr_hardware_interface::READY_TO_SWITCH);
+    popped++;
+  }
+  EXPECT_EQ(popped, 4u);
+  EXPECT_EQ(ring.dropped(), 396u);
+}
+
+TEST(TestSuite, statusSnapshots)
+{
+  typedef cnr_hardware_interface::StatusSnapshot Snapshot;
+  cnr_hardware_interface::StatusSnapshotRequests requests;
+  requests.request(Snapshot::FIRST_CONFIGURATION);
+  for (int i = 0; i < 10; i++)
+  {
+    requests.request(Snapshot::LAST_VALID_CONFIGURATION);
+  }
+  EXPECT_EQ(requests.depth(), 11u);
+
+  uint64_t stamp = 0;
+  const uint32_t pending = requests.take(stamp);
+  EXPECT_GT(stamp, 0u);
+  EXPECT_TRUE(cnr_hardware_interface::StatusSnapshotRequests::has(pending, Snapshot::FIRST_CONFIGURATION));
+  EXPECT_TRUE(cnr_hardware_interface::StatusSnapshotRequests::has(pending, Snapshot::LAST_VALID_CONFIGURATION));
+  EXPECT_FALSE(cnr_hardware_interface::StatusSnapshotRequests::has(pending, Snapshot::SHUTDOWN_CONFIGURATION));
+  EXPECT_EQ(requests.depth(), 0u);
+  EXPECT_EQ(requests.coalesced(), 9u);
+  EXPECT_EQ(requests.take(stamp), 0u);
+  EXPECT_EQ(stamp, 0u);
+
+  // a request concurrent with take() is never taken without its stamp
+  std::atomic<bool> stop(false);
+  std::thread producer([&requests, &stop]()
+  {
+    while (!stop)
+    {
+      requests.request(Snapshot::LAST_VALID_CONFIGURATION);
+    }
+  });
+  std::size_t taken = 0;
+  for (int i = 0; i < 100000 || taken == 0; i++)
+  {
+    if (requests.take(stamp) != 0)
+    {
+      EXPECT_GT(stamp, 0u);
+      EXPECT_LE(stamp, cnr_hardware_interface::monotonicNs());
+      taken++;
+    }
+  }
+  stop = true;
+  producer.join();
+  EXPECT_GT(taken, 0u);
+}
+
+TEST(TestSuite, hardwareBuffer)
+{
+  cnr_hardware_interface::HardwareBuffer buffer;
+  buffer.resize({"j1", "j2", "j3"}, {"a1"}, {"d1", "d2"});
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer.position().data()) % cnr_hardware_interface::kCacheLineSize, 0u);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer.commandEffort().data()) % cnr_hardware_interface::kCacheLineSize, 0u);
+  EXPECT_EQ(buffer.jointIndex("j2"), 1);
+
+  hardware_interface::PosVelEffJointInterface pve;
+  buffer.registerHandles(pve);
+  hardware_interface::PosVelEffJointHandle h = pve.getHandle("j2");
+  h.setCommand(1.0, 2.0, 3.0);
+  EXPECT_DOUBLE_EQ(buffer.commandPosition()[1], 1.0);
+  EXPECT_DOUBLE_EQ(buffer.commandEffort()[1], 3.0);
+  buffer.velocity()[1] = 4.0;
+  EXPECT_DOUBLE_EQ(h.getVelocity(), 4.0);
+
+  hardware_interface::DigitalCommandInterface digital;
+  buffer.registerHandles(digital);
+  digital.getHandle("d2").setCommand(true);
+  EXPECT_TRUE(buffer.digitalCommand()[1]);
+
+  buffer.resize({"j1"}, {}, {}, {"ft1", "ft2"}, {"ft1_frame", "ft2_frame"});
+  EXPECT_EQ(buffer.forceTorqueIndex("ft2"), 1);
+  EXPECT_EQ(buffer.wrench().size(), 12u);
+  hardware_interface::ForceTorqueInterface ft;
+  buffer.registerHandles(ft);
+  hardware_interface::ForceTorqueHandle ft2 = ft.getHandle("ft2");
+  EXPECT_EQ(ft2.getFrameId(), "ft2_frame");
+  buffer.wrench()[6 + 2] = 5.0;
+  buffer.wrench()[6 + 3] = 0.5;
+  EXPECT_DOUBLE_EQ(ft2.getForce()[2], 5.0);
+  EXPECT_DOUBLE_EQ(ft2.getTorque()[0], 0.5);
+  const double torque[3] = {1.0, 2.0, 3.0};
+  ft2.setTorque(torque);
+  EXPECT_DOUBLE_EQ(buffer.wrenchCommand()[6 + 5], 3.0);
+}
+
+TEST(TestSuite, jointGroupHandle)
+{
+  cnr_hardware_interface::HardwareBuffer buffer;
+  buffer.resize({"j1", "j2", "j3"});
+  hardware_interface::PosVelEffJointInterface pve;
+  buffer.registerHandles(pve);
+
+  hardware_interface::PosVelEffJointGroupHandle group = pve.getGroupHandle({"j1", "j2", "j3"});
+  EXPECT_TRUE(group.contiguous());
+  const double pos[3] = {1.0, 2.0, 3.0};
+  const double eff[3] = {4.0, 5.0, 6.0};
+  group.setCommands(pos, nullptr, eff);
+  EXPECT_DOUBLE_EQ(buffer.commandPosition()[2], 3.0);
+  EXPECT_DOUBLE_EQ(buffer.commandVelocity()[2], 0.0);
+  EXPECT_DOUBLE_EQ(buffer.commandEffort()[0], 4.0);
+
+  hardware_interface::PosVelEffJointGroupHandle reversed = pve.getGroupHandle({"j3", "j2", "j1"});
+  EXPECT_FALSE(reversed.contiguous());
+  buffer.position()[0] = 7.0;
+  double out[3];
+  reversed.getPositions(out);
+  EXPECT_DOUBLE_EQ(out[2], 7.0);
+  reversed.getCommandPositions(out);
+  EXPECT_DOUBLE_EQ(out[0], 3.0);
+}
+
+TEST(TestSuite, commandChannel)
+{
+  cnr_hardware_interface::HardwareBuffer buffer;
+  buffer.resize({"j1", "j2", "j3", "j4", "j5", "j6", "j7"}, {}, {}, {"ft"});
+  cnr_hardware_interface::CommandChannel channel;
+  channel.resize(buffer);
+  ASSERT_EQ(channel.front().wrench.size(), 6u);
+
+  std::thread producer([&]()
+  {
+    for (int k = 1; k <= 10000; k++)
+    {
+      std::fill(buffer.commandPosition().begin(), buffer.commandPosition().end(), static_cast<double>(k));
+      std::fill(buffer.commandEffort().begin(), buffer.commandEffort().end(), static_cast<double>(-k));
+      std::fill(buffer.wrenchCommand().begin(), buffer.wrenchCommand().end(), static_cast<double>(2 * k));
+      channel.publish(buffer);
+    }
+  });
+
+  uint64_t last_seq = 0;
+  while (last_seq < 10000)
+  {
+    if (!channel.fetch())
+    {
+      continue;
+    }
+    const cnr_hardware_interface::CommandFrame& frame = channel.front();
+    EXPECT_GT(frame.seq, last_seq);
+    last_seq = frame.seq;
+    for (std::size_t i = 0; i < frame.position.size(); i++)
+    {
+      ASSERT_DOUBLE_EQ(frame.position.at(i), static_cast<double>(frame.seq));
+      ASSERT_DOUBLE_EQ(frame.effort.at(i), -static_cast<double>(frame.seq));
+    }
+    for (const double w : frame.wrench)
+    {
+      ASSERT_DOUBLE_EQ(w, 2.0 * static_cast<double>(frame.seq));
+    }
+  }
+  producer.join();
+}
+
+TEST(TestSuite, forceTorqueHandle)
+{
+  double force[3] = {0}, torque[3] = {0}, output_force[3] = {0}, output_torque[3] = {0};
+  hardware_interface::ForceTorqueStateHandle state("ft", "tool0", force, torque);
+  hardware_interface::ForceTorqueHandle handle(state, output_force, output_torque);
+
+  const double cmd[3] = {1.0, 2.0, 3.0};
+  handle.setForce(cmd);
+  handle.setTorque(cmd);
+  EXPECT_DOUBLE_EQ(output_force[2], 3.0);
+  EXPECT_DOUBLE_EQ(output_torque[1], 2.0);
+  EXPECT_EQ(&handle.getName(), &handle.getName());
+  EXPECT_EQ(handle.getFrameId(), "tool0");
+
+  // no reference into a temporary handle
+  hardware_interface::ForceTorqueInterface iface;
+  iface.registerHandle(handle);
+  static_assert(std::is_same<decltype(iface.getHandle("ft").getName()), std::string>::value, "copy of a temporary");
+  static_assert(std::is_same<decltype(handle.getFrameId()), const std::string&>::value, "reference to a handle");
+  const std::string& frame_id = iface.getHandle("ft").getFrameId();
+  EXPECT_EQ(frame_id, "tool0");
+}
+
+TEST(TestSuite, paramCache)
+{
+  XmlRpc::XmlRpcValue root;
+  root["sampling_period"] = 0.002;
+  root["timing_window"] = 100;
+  root["joint_resource"]["joint_name"] = std::string("j1");
+
+  cnr_hardware_interface::ParamCache params;
+  EXPECT_TRUE(params.load("/robot_hw", root));
+  double period = 0;
+  EXPECT_TRUE(params.get("sampling_period", period));
+  EXPECT_DOUBLE_EQ(period, 0.002);
+  EXPECT_TRUE(params.get("timing_window", period));
+  EXPECT_DOUBLE_EQ(period, 100.0);
+
+  std::vector<std::string> names;
+  EXPECT_TRUE(params.get("joint_resource/joint_name", names));
+  ASSERT_EQ(names.size(), 1u);
+  EXPECT_EQ(names.front(), "j1");
+  EXPECT_FALSE(params.has("joint_resource/joint_names"));
+
+  bool rt_mode = true;
+  EXPECT_FALSE(params.get("rt_mode", rt_mode, false));
+  EXPECT_FALSE(rt_mode);
+}
+
+TEST(TestSuite, shmState)
+{
+  cnr_hardware_interface::HardwareBuffer buffer;
+  buffer.resize({"j1", "j2", "j3"}, {"a1"}, {"d1", "d2"}, {"ft"});
+  cnr_hardware_interface::PhaseTimingStats timing(10);
+  timing.record(cnr_hardware_interface::RTPhase::WRITE, 1000);
+
+  const std::string name = "/cnr_hw_test_" + std::to_string(::getpid());
+  cnr_hardware_interface::ShmStatePublisher publisher;
+  ASSERT_TRUE(publisher.create(name, buffer));
+
+  cnr_hardware_interface::ShmStateReader reader;
+  ASSERT_TRUE(reader.open(name));
+  ASSERT_EQ(reader.jointNames().size(), 3u);
+  EXPECT_EQ(reader.jointNames().at(2), "j3");
+  EXPECT_EQ(reader.digitalNames().at(1), "d2");
+  EXPECT_EQ(reader.forceTorqueNames().at(0), "ft");
+
+  cnr_hardware_interface::ShmStateSnapshot snapshot;
+  EXPECT_FALSE(reader.read(snapshot));
+
+  std::thread writer([&]()
+  {
+    for (uint64_t k = 1; k <= 10000; k++)
+    {
+      std::fill(buffer.position().begin(), buffer.position().end(), static_cast<double>(k));
+      buffer.commandEffort()[0] = -static_cast<double>(k);
+      buffer.digitalCommand()[1] = (k % 2) == 1;
+      buffer.wrench()[5] = static_cast<double>(k);
+      publisher.publish(k, cnr_hardware_interface::RUNNING, timing, buffer);
+    }
+  });
+
+  uint64_t last_cycle = 0;
+  while (last_cycle < 10000)
+  {
+    if (!reader.read(snapshot))
+    {
+      continue;
+    }
+    EXPECT_GE(snapshot.cycle, last_cycle);
+    last_cycle = snapshot.cycle;
+    for (const double& p : snapshot.position)
+    {
+      ASSERT_DOUBLE_EQ(p, static_cast<double>(snapshot.cycle));
+    }
+    ASSERT_DOUBLE_EQ(snapshot.command_effort.at(0), -static_cast<double>(snapshot.cycle));
+    ASSERT_EQ(snapshot.digital_command.at(1), (snapshot.cycle % 2) == 1);
+    ASSERT_DOUBLE_EQ(snapshot.wrench.at(5), static_cast<double>(snapshot.cycle));
+  }
+  writer.join();
+  EXPECT_EQ(snapshot.state, cnr_hardware_interface::RUNNING);
+  EXPECT_DOUBLE_EQ(snapshot.timing[static_cast<std::size_t>(cnr_hardware_interface::RTPhase::WRITE)].last, 1e-6);
+}
+
+TEST(TestSuite, blackBox)
+{
+  cnr_hardware_interface::HardwareBuffer buffer;
+  buffer.resize({"j1", "j2"}, {"a1"}, {"d1"}, {"ft"});
+  cnr_hardware_interface::PhaseTimingStats timing(10);
+  cnr_hardware_interface::BlackBoxRecorder recorder;
+  recorder.resize(buffer, 100);
+
+  for (uint64_t k = 1; k <= 250; k++)
+  {
+    buffer.position()[1] = static_cast<double>(k);
+    buffer.analogCommand()[0] = -static_cast<double>(k);
+    buffer.digitalValue()[0] = (k % 3) == 0;
+    buffer.wrenchCommand()[1] = 2.0 * static_cast<double>(k);
+    recorder.record(k, cnr_hardware_interface::RUNNING, timing, buffer);
+  }
+  EXPECT_FALSE(recorder.triggered());
+  recorder.trigger(cnr_hardware_interface::ERROR);
+  recorder.trigger(cnr_hardware_interface::CTRL_ERROR);
+  recorder.record(251, cnr_hardware_interface::ERROR, timing, buffer);  // frozen, discarded
+
+  const std::string path = "/tmp/cnr_hw_test_" + std::to_string(::getpid()) + ".bbx";
+  ASSERT_TRUE(recorder.dump(path));
+  EXPECT_FALSE(recorder.triggered());
+  EXPECT_EQ(recorder.dumps(), 1u);
+
+  cnr_hardware_interface::BlackBoxFile file;
+  ASSERT_TRUE(file.open(path));
+  ASSERT_EQ(file.samples(), 100u);
+  EXPECT_EQ(file.header().trigger_state, static_cast<uint32_t>(cnr_hardware_interface::ERROR));
+  EXPECT_EQ(file.jointNames().at(1), "j2");
+  EXPECT_EQ(file.forceTorqueNames().at(0), "ft");
+  EXPECT_EQ(file.cycle()[0], 151u);
+  EXPECT_EQ(file.cycle()[99], 250u);
+  for (std::size_t k = 0; k < file.samples(); k++)
+  {
+    EXPECT_DOUBLE_EQ(file.position(1)[k], static_cast<double>(file.cycle()[k]));
+    EXPECT_DOUBLE_EQ(file.analogCommand(0)[k], -static_cast<double>(file.cycle()[k]));
+    EXPECT_EQ(file.digitalValue(0)[k], (file.cycle()[k] % 3) == 0 ? 1u : 0u);
+    EXPECT_DOUBLE_EQ(file.wrenchCommand(0, 1)[k], 2.0 * static_cast<double>(file.cycle()[k]));
+    EXPECT_DOUBLE_EQ(file.wrench(0, 1)[k], 0.0);
+    EXPECT_EQ(file.state()[k], static_cast<uint64_t>(cnr_hardware_interface::RUNNING));
+  }
+  file.close();
+  std::remove(path.c_str());
+}
+
+TEST(TestSuite, parameterBlock)
+{
+  cnr_hardware_interface::ParameterBlock block;
+  const std::size_t kp = block.declare("kp", 10.0);
+  const std::size_t kd = block.declare("kd", 1.0);
+  EXPECT_EQ(block.index("kd"), kd);
+  EXPECT_EQ(block.index("ki"), block.size());
+  EXPECT_FALSE(block.commit());
+  EXPECT_DOUBLE_EQ(block.value(kp), 10.0);
+  EXPECT_EQ(block.version(), 0u);
+  block.seal();
+
+  std::string what;
+  EXPECT_FALSE(block.stage({{"kp", 20.0}, {"ki", 0.1}}, &what));
+  EXPECT_FALSE(block.commit());
+  EXPECT_DOUBLE_EQ(block.value(kp), 10.0);
+
+  EXPECT_TRUE(block.stage({{"kp", 20.0}}));
+  EXPECT_TRUE(block.stage({{"kd", 2.0}}));
+  EXPECT_DOUBLE_EQ(block.value(kp), 10.0);  // nothing changes up to the commit
+  EXPECT_TRUE(block.commit());
+  EXPECT_DOUBLE_EQ(block.value(kp), 20.0);
+  EXPECT_DOUBLE_EQ(block.value(kd), 2.0);
+  EXPECT_EQ(block.version(), 2u);
+  EXPECT_FALSE(block.commit());
+
+  // once sealed, a declaration does not replace the mailbox of a pending batch
+  EXPECT_TRUE(block.stage({{"kp", 30.0}}));
+  EXPECT_EQ(block.declare("ki", 0.1), block.size());
+  EXPECT_EQ(block.declare("kp", 0.0), block.size());
+  EXPECT_EQ(block.size(), 2u);
+  EXPECT_TRUE(block.commit());
+  EXPECT_DOUBLE_EQ(block.value(kp), 30.0);
+  block.unseal();
+  EXPECT_EQ(block.declare("ki", 0.1), 2u);
+}
+
+TEST(TestSuite, fixedSpan)
+{
+  cnr_hardware_interface::HardwareBuffer buffer;
+  buffer.resize({"j1", "j2", "j3"});
+  cnr_hardware_interface::FixedSpan<double, 3> position(buffer.position().data());
+  cnr_hardware_interface::FixedSpan<double, 3> command(buffer.commandPosition().data());
+
+  position.assign(std::array<double, 3>{{-2.0, 0.5, 2.0}});
+  EXPECT_DOUBLE_EQ(position.get<2>(), 2.0);
+  command.assign(position);
+  EXPECT_DOUBLE_EQ(buffer.commandPosition()[0], -2.0);
+
+  const std::bitset<3> saturated = command.clamp({{-1.0, -1.0, -1.0}}, {{1.0, 1.0, 1.0}});
+  EXPECT_EQ(saturated.to_ulong(), 0x5u);
+  EXPECT_DOUBLE_EQ(command[0], -1.0);
+  EXPECT_DOUBLE_EQ(command[1], 0.5);
+  EXPECT_DOUBLE_EQ(command.toArray()[2], 1.0);
+  static_assert(cnr_hardware_interface::FixedSpan<double, 3>::size() == 3, "size known at compile time");
+}
+
+TEST(TestSuite, ioChanges)
+{
+  std::vector<std::string> digitals;
+  for (int i = 0; i < 130; i++)
+  {
+    digitals.push_back("d" + std::to_string(i));
+  }
+  cnr_hardware_interface::HardwareBuffer buffer;
+  buffer.resize({"j1"}, {"a1", "a2"}, digitals);
+  cnr_hardware_interface::IOChangeDetector changes;
+  changes.resize(buffer, 0.1);
+  ASSERT_EQ(changes.digitalWords(), 3u);
+
+  changes.update(buffer);  // the first update flags all the channels
+  std::size_t n = 0;
+  changes.forEachDigitalChange([&n](std::size_t, bool) { n++; });
+  EXPECT_EQ(n, 130u);
+  changes.update(buffer);
+  EXPECT_FALSE(changes.anyChange());
+
+  buffer.digitalValue()[3] = true;
+  buffer.digitalValue()[129] = true;
+  buffer.analogValue()[0] = 0.05;  // within the deadband
+  buffer.analogValue()[1] = 0.5;
+  changes.update(buffer);
+  std::vector<std::size_t> toggled;
+  changes.forEachDigitalChange([&toggled](std::size_t channel, bool value)
+  {
+    EXPECT_TRUE(value);
+    toggled.push_back(channel);
+  });
+  EXPECT_EQ(toggled, std::vector<std::size_t>({3, 129}));
+  EXPECT_EQ(changes.digitalWord(2), 0x2u);
+  std::vector<std::size_t> moved;
+  changes.forEachAnalogChange([&moved](std::size_t channel, double value)
+  {
+    EXPECT_DOUBLE_EQ(value, 0.5);
+    moved.push_back(channel);
+  });
+  EXPECT_EQ(moved, std::vector<std::size_t>({1}));
+
+  buffer.analogValue()[0] = 0.15;  // 0.15 from the last flagged value (0.0)
+  changes.update(buffer);
+  EXPECT_EQ(changes.analogDirty(0), 0x1u);
+  EXPECT_EQ(changes.digitalDirty(0), 0u);
+}
+
+TEST(TestSuite, wrenchProcessing)
+{
+  cnr_hardware_interface::WrenchProcessingConfig config;
+  config.cutoff_frequency = 10.0;
+  config.force_limit      = 100.0;
+  config.translation      = {{0.0, 0.0, 0.1}};
+  config.rotation_rpy     = {{0.0, 0.0, M_PI / 2.0}};
+  cnr_hardware_interface::WrenchProcessor ft;
+  ft.configure(config, 1e-3);
+
+  double force[3] = {1.0, 0.0, 0.0}, torque[3] = {0.0, 0.0, 0.0};
+  ft.update(force, torque);  // steady state at the first sample
+  EXPECT_NEAR(ft.force()[0], 0.0, 1e-9);
+  EXPECT_NEAR(ft.force()[1], 1.0, 1e-9);  // x of the sensor is y of the output frame
+  EXPECT_NEAR(ft.torque()[0], -0.1, 1e-9);  // p x F, with p = (0, 0, 0.1) and F = (0, 1, 0)
+
+  force[0] = 2.0;
+  ft.update(force, torque);
+  EXPECT_GT(ft.force()[1], 1.0);
+  EXPECT_LT(ft.force()[1], 1.1);  // low-pass
+  for (int i = 0; i < 1000; i++)
+  {
+    ft.update(force, torque);
+  }
+  EXPECT_NEAR(ft.force()[1], 2.0, 1e-6);
+
+  ft.tare();
+  ft.update(force, torque);
+  EXPECT_NEAR(ft.force()[1], 0.0, 1e-6);
+  EXPECT_NEAR(ft.bias()[0], 2.0, 1e-6);
+  EXPECT_FALSE(ft.saturated().any());
+
+  force[2] = -150.0;
+  ft.update(force, torque);
+  EXPECT_TRUE(ft.saturated().test(2));
+}
+
+TEST(TestSuite, commandLimits)
+{
+  cnr_hardware_interface::HardwareBuffer buffer;
+  buffer.resize({"j1", "j2"});
+  hardware_interface::PosVelEffJointHandle j1 = buffer.posVelEffHandle(0);
+  hardware_interface::PosVelEffJointHandle j2 = buffer.posVelEffHandle(1);
+
+  cnr_hardware_interface::CommandLimiter limits;
+  limits.resize(2);
+  limits.setPositionLimits(0, -1.0, 1.0);
+  limits.setVelocityLimit(1, 2.0);
+  limits.setWatchdog(3);
+
+  j1.setCommand(1.5, 10.0, 0.0);
+  j2.setCommand(1.5, -10.0, 0.0);
+  buffer.position()[1] = 0.3;
+  EXPECT_EQ(limits.apply(buffer), 2u);
+  EXPECT_DOUBLE_EQ(j1.getCommandPosition(), 1.0);
+  EXPECT_DOUBLE_EQ(j1.getCommandVelocity(), 10.0);
+  EXPECT_DOUBLE_EQ(j2.getCommandPosition(), 1.5);
+  EXPECT_DOUBLE_EQ(j2.getCommandVelocity(), -2.0);
+  EXPECT_EQ(limits.saturations(), 2u);
+
+  // j2 is not commanded anymore: it becomes stale after 3 checks, while j1 (or a never commanded joint) is fine
+  EXPECT_TRUE(limits.check(buffer));
+  for (int i = 0; i < 3; i++)
+  {
+    j1.setCommandPosition(0.0);
+    EXPECT_TRUE(limits.check(buffer));
+  }
+  j1.setCommandPosition(0.0);
+  buffer.commandVelocity()[1] = 1.0;  // not a new command, the counter is not changed
+  EXPECT_FALSE(limits.check(buffer));
+  EXPECT_EQ(limits.staleJoint(), 1);
+  EXPECT_EQ(limits.staleEvents(), 1u);
+
+  // ... and its commands are replaced by the hold at the measured position, up to its next command
+  EXPECT_EQ(limits.heldJoints(), 1u);
+  EXPECT_DOUBLE_EQ(j2.getCommandPosition(), 0.3);
+  EXPECT_DOUBLE_EQ(j2.getCommandVelocity(), 0.0);
+  EXPECT_DOUBLE_EQ(j2.getCommandEffort(), 0.0);
+  buffer.position()[1]        = 0.4;
+  buffer.commandVelocity()[1] = 1.0;
+  j1.setCommandPosition(0.0);
+  EXPECT_TRUE(limits.check(buffer));
+  EXPECT_DOUBLE_EQ(j2.getCommandPosition(), 0.3);
+  EXPECT_DOUBLE_EQ(j2.getCommandVelocity(), 0.0);
+
+  // the group handle refreshes all its joints at once
+  hardware_interface::PosVelEffJointGroupHandle group({j1, j2});
+  const double cmd[2] = {0.0, 0.0};
+  group.setCommands(cmd, nullptr, nullptr);
+  limits.disarm();
+  for (int i = 0; i < 10; i++)
+  {
+    group.setCommands(cmd, cmd, cmd);
+    EXPECT_TRUE(limits.check(buffer));
+  }
+  EXPECT_EQ(limits.heldJoints(), 0u);
+
+  // a non-finite command is not a saturation: the joint is held at the last valid position command
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const uint64_t saturations = limits.saturations();
+  j1.setCommand(0.5, 0.0, 0.0);
+  limits.apply(buffer);
+  EXPECT_EQ(limits.invalidJoint(), -1);
+  j1.setCommand(nan, 1.0, 1.0);
+  limits.apply(buffer);
+  EXPECT_EQ(limits.invalidJoint(), 0);
+  EXPECT_DOUBLE_EQ(j1.getCommandPosition(), 0.5);
+  EXPECT_DOUBLE_EQ(j1.getCommandVelocity(), 0.0);
+  EXPECT_DOUBLE_EQ(j1.getCommandEffort(), 0.0);
+  j1.setCommand(0.5, std::numeric_limits<double>::infinity(), 0.0);
+  limits.apply(buffer);
+  EXPECT_EQ(limits.invalidJoint(), 0);
+  EXPECT_DOUBLE_EQ(j1.getCommandVelocity(), 0.0);
+  EXPECT_EQ(limits.invalidEvents(), 2u);
+  EXPECT_EQ(limits.saturations(), saturations);
+
+  // ... or at the measured position, if it has never had a valid command
+  cnr_hardware_interface::CommandLimiter fresh;
+  fresh.resize(2);
+  buffer.position()[1] = 0.4;
+  j2.setCommand(0.0, nan, 0.0);
+  fresh.apply(buffer);
+  EXPECT_EQ(fresh.invalidJoint(), 1);
+  EXPECT_DOUBLE_EQ(j2.getCommandPosition(), 0.4);
+  EXPECT_DOUBLE_EQ(j2.getCommandVelocity(), 0.0);
+
+  // a velocity controlled joint has never had a position command: the 0.0 of the column is not a valid command
+  cnr_hardware_interface::HardwareBuffer vel_buffer;
+  vel_buffer.resize({"j1"});
+  hardware_interface::VelEffJointHandle vj = vel_buffer.velEffHandle(0);
+  cnr_hardware_interface::CommandLimiter vel_limits;
+  vel_limits.resize(1);
+  vel_buffer.position()[0] = 0.7;
+  vj.setCommand(0.5, 0.0);
+  vel_limits.apply(vel_buffer);
+  EXPECT_EQ(vel_limits.invalidJoint(), -1);
+  vel_buffer.position()[0] = 0.8;
+  vj.setCommand(nan, 0.0);
+  vel_limits.apply(vel_buffer);
+  EXPECT_EQ(vel_limits.invalidJoint(), 0);
+  EXPECT_DOUBLE_EQ(vel_buffer.commandPosition()[0], 0.8);
+  EXPECT_DOUBLE_EQ(vj.getCommandVelocity(), 0.0);
+
+  // ... and neither is the hold itself, at the next fault
+  vj.setCommand(0.5, 0.0);
+  vel_limits.apply(vel_buffer);
+  vel_buffer.position()[0] = 0.9;
+  vj.setCommand(nan, 0.0);
+  vel_limits.apply(vel_buffer);
+  EXPECT_DOUBLE_EQ(vel_buffer.commandPosition()[0], 0.9);
+}
+
+TEST(TestSuite, subDevices)
+{
+  typedef cnr_hardware_interface::SubDeviceScheduler Scheduler;
+  Scheduler scheduler;
+  int io_reads = 0, ft_reads = 0, ft_writes = 0;
+  EXPECT_TRUE(scheduler.add("io", [&io_reads]() { io_reads++; return true; }, Scheduler::Callback(), 40, 3, 0));
+  EXPECT_TRUE(scheduler.add("ft", [&ft_reads]() { ft_reads++; return ft_reads != 2; },
+                            [&ft_writes]() { ft_writes++; return true; }, 4, 1, 0));
+  EXPECT_FALSE(scheduler.add("ft", Scheduler::Callback(), Scheduler::Callback(), 4, 0, 0));
+  EXPECT_FALSE(scheduler.add("bad", Scheduler::Callback(), Scheduler::Callback(), 4, 4, 0));
+
+  std::vector<uint64_t> failed_cycles;
+  for (uint64_t cycle = 0; cycle < 80; cycle++)
+  {
+    const Scheduler::SubDevice* failed = scheduler.dispatch(Scheduler::Stage::READ, cycle);
+    if (failed)
+    {
+      EXPECT_EQ(failed->name, "ft");
+      failed_cycles.push_back(cycle);
+    }
+    EXPECT_EQ(scheduler.dispatch(Scheduler::Stage::WRITE, cycle), nullptr);
+  }
+  EXPECT_EQ(io_reads, 2);   // cycles 3 and 43
+  EXPECT_EQ(ft_reads, 20);  // cycles 1, 5, 9, ...
+  EXPECT_EQ(ft_writes, 20);
+  EXPECT_EQ(failed_cycles, std::vector<uint64_t>({5}));
+
+  const Scheduler::SubDevice* ft = scheduler.find("ft");
+  ASSERT_NE(ft, nullptr);
+  EXPECT_EQ(ft->stats[0].calls.load(), 20u);
+  EXPECT_EQ(ft->stats[0].failures.load(), 1u);
+  EXPECT_EQ(ft->stats[0].overruns.load(), 0u);
+
+  // a new init() registers the same sub-devices again
+  scheduler.clear();
+  EXPECT_EQ(scheduler.size(), 0u);
+  EXPECT_EQ(scheduler.dispatch(Scheduler::Stage::READ, 0), nullptr);
+  EXPECT_TRUE(scheduler.add("io", [&io_reads]() { io_reads++; return true; }, Scheduler::Callback(), 40, 3, 0));
+}
+
+TEST(TestSuite, rtAllocGuard)
+{
+  cnr_hardware_interface::RTAllocStats stats;
+  std::mutex mutex;
+  const std::size_t bytes = 16 * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  char* pages = static_cast<char*>(mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  ASSERT_NE(pages, MAP_FAILED);
+  {
+    cnr_hardware_interface::RTAllocGuard guard(stats);
+    {
+      cnr_hardware_interface::RTAllocGuard nested(stats);  // only the outermost guard accumulates
+      std::unique_ptr<int> p(new int(1));
+      std::unique_ptr<int[]> a(new (std::nothrow) int[4]);
+    }
+#if defined(__cpp_aligned_new)
+    ::operator delete(::operator new(64, std::align_val_t(64)), std::align_val_t(64));
+#endif
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::size_t i = 0; i < bytes; i += 64)
+    {
+      pages[i] = 1;  // the first touch of each page is a minor fault
+    }
+  }
+  munmap(pages, bytes);
+
+  if (!cnr_hardware_interface::rtAllocTrackingEnabled())
+  {
+    EXPECT_EQ(stats.sections(), 0u);
+    EXPECT_EQ(stats.allocations(), 0u);
+    return;
+  }
+  EXPECT_EQ(stats.sections(), 1u);
+#if defined(__cpp_aligned_new)
+  EXPECT_EQ(stats.allocations(), 3u);
+#else
+  EXPECT_EQ(stats.allocations(), 2u);
+#endif
+  EXPECT_EQ(stats.worstAllocations(), stats.allocations());
+  EXPECT_GE(stats.locks(), 1u);
+  EXPECT_GE(stats.minorFaults(), 1u);
+
+  // a section without allocations does not change the worst one
+  {
+    cnr_hardware_interface::RTAllocGuard guard(stats);
+  }
+  EXPECT_EQ(stats.sections(), 2u);
+  EXPECT_EQ(stats.worstAllocations(), stats.allocations());
+}
+
+// The logger of the mock is already initialized, so that RobotHW::init() fails in creating it
+class TestRobotHW : public cnr_hardware_interface::RobotHW
+{
+public:
+  explicit TestRobotHW(const std::string& name)
+    : reads(0), writes(0), stall_read(0), stall_write(0), fail_init_rt(false), fail_prepare_switch(false), name_(name)
+  {
+    m_logger.init("test_hw_" + name, "/file_and_screen_different_appenders", false, false);
+  }
+  ~TestRobotHW()
+  {
+    shutdown();
+  }
+
+  // written by the RT thread, to be read after the executor is stopped
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t stall_read;   // the doRead() that lasts 'stall', 0 if none
+  uint64_t stall_write;  // the doWrite() that lasts 'stall', 0 if none
+  std::chrono::milliseconds stall;
+  bool fail_init_rt;
+  bool fail_prepare_switch;
+  std::function<void(const std::string&)> trace;  // called with "<name>.read" and "<name>.write"
+
+  bool initRT() override
+  {
+    return !fail_init_rt;
+  }
+
+  const std::list<hardware_interface::ControllerInfo>& activeControllers() const
+  {
+    return m_active_controllers;
+  }
+  using cnr_hardware_interface::RobotHW::registerSubDevice;
+
+protected:
+  bool doRead(const ros::Time& /*time*/, const ros::Duration& /*period*/) override
+  {
+    if (++reads == stall_read)
+    {
+      std::this_thread::sleep_for(stall);
+    }
+    if (trace)
+    {
+      trace(name_ + ".read");
+    }
+    return true;
+  }
+  bool doWrite(const ros::Time& /*time*/, const ros::Duration& /*period*/) override
+  {
+    if (++writes == stall_write)
+    {
+      std::this_thread::sleep_for(stall);
+    }
+    if (trace)
+    {
+      trace(name_ + ".write");
+    }
+    return true;
+  }
+  bool doPrepareSwitch(const std::list<hardware_interface::ControllerInfo>& /*start_list*/,
+                       const std::list<hardware_interface::ControllerInfo>& /*stop_list*/) override
+  {
+    return !fail_prepare_switch;
+  }
+
+private:
+  std::string name_;
+};
+
+TEST(TestSuite, initAsyncFailure)
+{
+  TestRobotHW hw("init_async");
+  ros::NodeHandle root_nh;
+  ros::NodeHandle robot_hw_nh("~");
+  std::future<bool> ok = hw.initAsync(root_nh, robot_hw_nh);
+  EXPECT_FALSE(ok.get());
+  EXPECT_EQ(hw.getState(), cnr_hardware_interface::ERROR);
+}
+
+// No SCHED_FIFO (priority 0), so that the test does not need the RT privileges
+TEST(TestSuite, rtExecutor)
+{
+  std::shared_ptr<TestRobotHW> hw(new TestRobotHW("rt_executor"));
+  hw->stall_read = 10;
+  hw->stall      = std::chrono::milliseconds(20);
+  uint64_t updates = 0;
+  cnr_hardware_interface::RTExecutorOptions options;
+  options.period = 0.005;
+  cnr_hardware_interface::RTExecutor executor(hw, [&updates](const ros::Time&, const ros::Duration& period)
+  {
+    EXPECT_DOUBLE_EQ(period.toSec(), 0.005);
+    updates++;
+  }, options);
+
+  std::string what;
+  ASSERT_TRUE(executor.start(&what)) << what;
+  EXPECT_TRUE(executor.isRunning());
+  EXPECT_FALSE(executor.start(&what));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  executor.stop();
+  EXPECT_FALSE(executor.isRunning());
+
+  // the 10th cycle lasts 4 periods: the missed deadlines are skipped, not recovered
+  const uint64_t cycles = executor.cycles();
+  EXPECT_GT(cycles, 10u);
+  EXPECT_LE(cycles, 40u);
+  EXPECT_EQ(hw->reads, cycles);
+  EXPECT_EQ(hw->writes, cycles);
+  EXPECT_EQ(updates, cycles);
+  EXPECT_GE(executor.missedCycles(), 3u);
+
+  std::shared_ptr<MainThreadSharedData> data = executor.sharedData();
+  EXPECT_DOUBLE_EQ(data->getCycleTime(), 0.005);
+  EXPECT_GE(data->getMaxMissedCycles(), 3u);
+  EXPECT_LE(data->getMaxMissedCycles(), executor.missedCycles());
+  EXPECT_GE(data->getMaxCalcTime(), 20.0);  // [ms]
+}
+
+TEST(TestSuite, combinedRTExecutor)
+{
+  // the events of each cycle: the reads, the update, then the writes
+  std::vector<std::vector<std::string>> cycles;
+  std::function<void(const std::string&)> trace = [&cycles](const std::string& what)
+  {
+    if (cycles.empty() || (what.find(".read") != std::string::npos && cycles.back().back().find(".read") == std::string::npos))
+    {
+      cycles.emplace_back();
+    }
+    cycles.back().push_back(what);
+  };
+  std::shared_ptr<TestRobotHW> arm(new TestRobotHW("arm"));
+  std::shared_ptr<TestRobotHW> gripper(new TestRobotHW("gripper"));
+  std::shared_ptr<TestRobotHW> ft(new TestRobotHW("ft"));
+  arm->trace = gripper->trace = ft->trace = trace;
+
+  cnr_hardware_interface::CombinedRTExecutor executor;
+  cnr_hardware_interface::RTExecutorOptions options;
+  options.period = 0.005;
+  EXPECT_TRUE(executor.addGroup("arm", [&trace](const ros::Time&, const ros::Duration&) { trace("update"); }, options));
+  EXPECT_FALSE(executor.addGroup("arm", nullptr, options));
+  EXPECT_TRUE(executor.addMember("arm", cnr_hardware_interface::RTMember(arm)));
+  EXPECT_TRUE(executor.addMember("arm", cnr_hardware_interface::RTMember(gripper, 2, 0)));
+  EXPECT_TRUE(executor.addMember("arm", cnr_hardware_interface::RTMember(ft, 4, 1)));
+  EXPECT_FALSE(executor.addMember("leg", cnr_hardware_interface::RTMember(ft)));
+
+  std::string what;
+  ASSERT_TRUE(executor.start(&what)) << what;
+  EXPECT_FALSE(executor.addMember("arm", cnr_hardware_interface::RTMember(ft)));
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));  // 100 ms up to the cycle 0
+  const uint32_t missed = executor.sharedData("arm")->getMaxMissedCycles();
+  executor.stop();
+  EXPECT_EQ(executor.sharedData("arm"), nullptr);
+
+  ASSERT_GT(cycles.size(), 8u);
+  for (std::size_t k = 0; k < cycles.size(); k++)
+  {
+    const std::vector<std::string>& events = cycles[k];
+    std::vector<std::string>::const_iterator update = std::find(events.begin(), events.end(), "update");
+    ASSERT_NE(update, events.end());
+    std::vector<std::string> reads(events.begin(), update);
+    std::vector<std::string> writes(update + 1, events.end());
+    if (k + 1 == cycles.size() && writes.empty())
+    {
+      break;
+    }
+    for (std::string& r : reads)
+    {
+      r.replace(r.find(".read"), 5, ".write");
+    }
+    EXPECT_EQ(reads, writes) << "cycle " << k;
+
+    // the cycle counter follows the time: without overruns the recorded cycles are the cycles of the executor
+    if (missed == 0)
+    {
+      std::vector<std::string> expected = {"arm.write"};
+      if (k % 2 == 0)
+      {
+        expected.push_back("gripper.write");
+      }
+      if (k % 4 == 1)
+      {
+        expected.push_back("ft.write");
+      }
+      EXPECT_EQ(writes, expected) << "cycle " << k;
+    }
+  }
+
+  // a group that fails to start stops the ones already started, before their cycle 0
+  std::shared_ptr<TestRobotHW> broken(new TestRobotHW("broken"));
+  broken->fail_init_rt = true;
+  const uint64_t arm_reads = arm->reads;
+  cnr_hardware_interface::CombinedRTExecutor rollback;
+  EXPECT_TRUE(rollback.addGroup("a", nullptr, options));
+  EXPECT_TRUE(rollback.addGroup("b", nullptr, options));
+  EXPECT_TRUE(rollback.addMember("a", cnr_hardware_interface::RTMember(arm)));
+  EXPECT_TRUE(rollback.addMember("b", cnr_hardware_interface::RTMember(broken)));
+  EXPECT_FALSE(rollback.start(&what));
+  EXPECT_NE(what.find("Group 'b'"), std::string::npos) << what;
+  EXPECT_EQ(rollback.sharedData("a"), nullptr);
+  EXPECT_EQ(arm->reads, arm_reads);
+  EXPECT_EQ(broken->reads, 0u);
+  EXPECT_TRUE(rollback.addMember("b", cnr_hardware_interface::RTMember(gripper)));
+}
+
+TEST(TestSuite, prepareSwitchFailure)
+{
+  TestRobotHW hw("prepare_switch");
+  std::list<hardware_interface::ControllerInfo> start(1), stop(1);
+  start.front().name = "ctrl1";
+  stop.front().name  = "ctrl2";
+  EXPECT_TRUE(hw.prepareSwitch(stop, {}));
+  ASSERT_EQ(hw.activeControllers().size(), 1u);
+
+  // a switch refused by doPrepareSwitch() does not change the active controllers
+  hw.fail_prepare_switch = true;
+  EXPECT_FALSE(hw.prepareSwitch(start, stop));
+  ASSERT_EQ(hw.activeControllers().size(), 1u);
+  EXPECT_EQ(hw.activeControllers().front().name, "ctrl2");
+  EXPECT_EQ(hw.switchResult(start.front()), hardware_interface::RobotHW::SwitchState::DONE);
+
+  hw.fail_prepare_switch = false;
+  EXPECT_TRUE(hw.prepareSwitch(start, stop));
+  ASSERT_EQ(hw.activeControllers().size(), 1u);
+  EXPECT_EQ(hw.activeControllers().front().name, "ctrl1");
+}
+
+TEST(TestSuite, subDeviceTime)
+{
+  TestRobotHW hw("sub_device_time");
+  std::vector<double> times;
+  auto record = [&times](const ros::Time& time, const ros::Duration&) { times.push_back(time.toSec()); return true; };
+  ASSERT_TRUE(hw.registerSubDevice("io", record, record, 1, 0, 0.0));
+
+  // the write stage gets the time of write(), not the one of read()
+  const ros::Duration period(0.01);
+  hw.read(ros::Time(1.0), period);
+  hw.write(ros::Time(2.0), period);
+  EXPECT_EQ(times, std::vector<double>({1.0, 2.0}));
+}
+
+TEST(TestSuite, phaseTiming)
+{
+  typedef cnr_hardware_interface::RTPhase RTPhase;
+  TestRobotHW hw("phase_timing");
+  hw.stall_read  = 1;
+  hw.stall_write = 1;
+  hw.stall       = std::chrono::milliseconds(5);
+  const ros::Duration period(0.001);
+  for (int i = 0; i < 2; i++)
+  {
+    hw.read(ros::Time(1.0), period);
+    hw.write(ros::Time(1.0), period);
+  }
+
+  const cnr_hardware_interface::PhaseTimingStats& timing = hw.phaseTiming();
+  for (const RTPhase phase : { RTPhase::READ, RTPhase::READ_CALLBACKS, RTPhase::DO_READ, RTPhase::WRITE,
+                               RTPhase::DO_WRITE })
+  {
+    EXPECT_EQ(timing.statistics(phase).samples, 2u) << cnr_hardware_interface::to_string(phase);
+    EXPECT_EQ(timing.histogram(phase).count(), 2u) << cnr_hardware_interface::to_string(phase);
+  }
+  EXPECT_EQ(timing.statistics(RTPhase::CYCLE).samples, 1u);  // between the two read()
+  EXPECT_EQ(timing.statistics(RTPhase::SWITCH).samples, 0u);
+
+  // the phase of the derived class is included in the one of the whole method
+  EXPECT_GE(timing.statistics(RTPhase::DO_READ).max, 0.005);
+  EXPECT_GE(timing.statistics(RTPhase::READ).max, timing.statistics(RTPhase::DO_READ).max);
+  EXPECT_GE(timing.statistics(RTPhase::DO_WRITE).max, 0.005);
+  EXPECT_GE(timing.statistics(RTPhase::WRITE).max, timing.statistics(RTPhase::DO_WRITE).max);
+  EXPECT_GE(timing.statistics(RTPhase::CYCLE).max, 0.010);
+  EXPECT_LT(timing.statistics(RTPhase::DO_READ).min, 0.005);
+}
+
+// the trace of the RT methods, as built with the cmake option CNR_HW_RT_TRACE=ON and =OFF. 'uses' counts the
+// evaluations of the logger, i.e. the traces actually built
+int tracedCycle(cnr_logger::TraceLogger& logger, int& uses, const bool rt_mode)
+{
+  CNR_HW_RT_TRACE_START((++uses, logger), rt_mode);
+  CNR_HW_RT_RETURN_OK((++uses, logger), rt_mode, 1);
+}
+
+#undef CNR_HARDWARE_INTERFACE_INTERNAL_RT_TRACE_H
+#undef CNR_HW_RT_TRACE_START
+#undef CNR_HW_RT_RETURN_OK
+#define CNR_HARDWARE_INTERFACE_DISABLE_RT_TRACE
+#include <cnr_hardware_interface/internal/rt_trace.h>  // NOLINT
+
+int untracedCycle(cnr_logger::TraceLogger& logger, int& uses, const bool rt_mode)
+{
+  (void)logger;  // the macros drop their arguments
+  (void)uses;
+  CNR_HW_RT_TRACE_START((++uses, logger), rt_mode);
+  CNR_HW_RT_RETURN_OK((++uses, logger), rt_mode, 1);
+}
+
+TEST(TestSuite, rtTrace)
+{
+  cnr_logger::TraceLogger logger("rt_trace", "/file_and_screen_different_appenders");
+  int uses = 0;
+  EXPECT_EQ(tracedCycle(logger, uses, true), 1);
+  EXPECT_EQ(uses, 0);  // rt mode: the logger is not touched
+  EXPECT_EQ(tracedCycle(logger, uses, false), 1);
+  EXPECT_EQ(uses, 2);
+
+  // compiled out: never traced, whatever the mode
+  uses = 0;
+  EXPECT_EQ(untracedCycle(logger, uses, true), 1);
+  EXPECT_EQ(untracedCycle(logger, uses, false), 1);
+  EXPECT_EQ(uses, 0);
+}
+
 
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv)